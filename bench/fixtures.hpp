@@ -0,0 +1,74 @@
+/**
+ * @file fixtures.hpp
+ * @brief Deterministic JSON payloads of configurable size for benchmarks.
+ */
+
+#ifndef JFETCH_BENCH_FIXTURES_HPP
+#define JFETCH_BENCH_FIXTURES_HPP
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+namespace jfetch_bench {
+
+/**
+ * @brief One product record, shaped like the dummyjson.com payloads used in `examples/`.
+ */
+inline nlohmann::json product(int id) {
+  return {
+    {"id", id},
+    {"title", "Product number " + std::to_string(id)},
+    {"description", "A reasonably long description string that makes the record look like real API data."},
+    {"price", 9.99 + id},
+    {"rating", 4.5},
+    {"tags", {"beauty", "mascara", "bench"}},
+    {"dimensions", {{"width", 23.17}, {"height", 14.43}, {"depth", 28.01}}},
+    {"reviews", {{{"rating", 2}, {"comment", "Very unhappy with my purchase!"}, {"reviewer", "John Doe"}},
+                 {{"rating", 5}, {"comment", "Very satisfied!"}, {"reviewer", "Jane Roe"}}}},
+  };
+}
+
+/**
+ * @brief `{"products": [...], "total": n}` grown until it is at least `bytes` long.
+ */
+inline std::string products_payload(std::size_t bytes) {
+  nlohmann::json products = nlohmann::json::array();
+  std::string text;
+  int id = 0;
+  do {
+    products.push_back(product(++id));
+    text = nlohmann::json{{"products", products}, {"total", id}}.dump();
+  } while (text.size() < bytes && id < 4);
+
+  // grow in larger steps once the record size is known
+  while (text.size() < bytes) {
+    std::size_t per_record = text.size() / static_cast<std::size_t>(id);
+    std::size_t missing = (bytes - text.size()) / per_record + 1;
+    for (std::size_t i = 0; i < missing; ++i) {
+      products.push_back(product(++id));
+    }
+    text = nlohmann::json{{"products", products}, {"total", id}}.dump();
+  }
+  return text;
+}
+
+/**
+ * @brief Objects nested `depth` levels deep, each level holding `width` small members.
+ */
+inline std::string nested_payload(int depth, int width) {
+  nlohmann::json node = {{"leaf", true}};
+  for (int level = 0; level < depth; ++level) {
+    nlohmann::json parent;
+    for (int i = 0; i < width; ++i) {
+      parent["field_" + std::to_string(i)] = "value " + std::to_string(level * width + i);
+    }
+    parent["list"] = nlohmann::json::array({level, level + 1, level + 2});
+    parent["child"] = std::move(node);
+    node = std::move(parent);
+  }
+  return node.dump();
+}
+
+}  // namespace jfetch_bench
+
+#endif  // JFETCH_BENCH_FIXTURES_HPP
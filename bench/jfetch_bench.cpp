@@ -0,0 +1,698 @@
+#include "../include/jfetch.hpp"
+#include "fixtures.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include "../include/jfetch_uring.hpp"
+#define JFETCH_BENCH_URING 1
+#endif
+
+#include <benchmark/benchmark.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <cstdlib>
+#include <new>
+
+#include <unistd.h>
+#include <malloc.h>
+
+#if defined(JFETCH_WITH_BROTLI)
+#include <brotli/encode.h>
+#endif
+
+// count C++ heap allocations made by the benchmarking thread (the server's threads are excluded)
+static thread_local std::size_t allocations = 0;
+// bytes of C++ heap live on the benchmarking thread, and their high-water mark (see BM_FetchEach)
+static thread_local long long live_bytes = 0;
+static thread_local long long peak_bytes = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1)) {
+    live_bytes += static_cast<long long>(malloc_usable_size(p));
+    peak_bytes = std::max(peak_bytes, live_bytes);
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  live_bytes -= static_cast<long long>(malloc_usable_size(p));
+  std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+// typed mirror of jfetch_bench::product() for BM_DecodeMapped
+namespace jfetch_bench {
+
+struct Review {
+  int rating = 0;
+  std::string comment;
+  std::string reviewer;
+};
+
+struct Dimensions {
+  double width = 0;
+  double height = 0;
+  double depth = 0;
+};
+
+struct Product {
+  int id = 0;
+  std::string title;
+  std::string description;
+  double price = 0;
+  double rating = 0;
+  std::vector<std::string> tags;
+  Dimensions dimensions;
+  std::vector<Review> reviews;
+};
+
+struct Catalog {
+  std::vector<Product> products;
+  int total = 0;
+};
+
+}  // namespace jfetch_bench
+
+JFETCH_FIELDS(jfetch_bench::Review, JFETCH_FIELD(rating), JFETCH_FIELD(comment), JFETCH_FIELD(reviewer));
+JFETCH_FIELDS(jfetch_bench::Dimensions, JFETCH_FIELD(width), JFETCH_FIELD(height), JFETCH_FIELD(depth));
+JFETCH_FIELDS(jfetch_bench::Product, JFETCH_FIELD(id), JFETCH_FIELD(title), JFETCH_FIELD(description),
+              JFETCH_FIELD(price), JFETCH_FIELD(rating), JFETCH_FIELD(tags), JFETCH_FIELD(dimensions),
+              JFETCH_FIELD(reviews));
+JFETCH_FIELDS(jfetch_bench::Catalog, JFETCH_FIELD(products), JFETCH_FIELD(total));
+
+namespace {
+
+const std::size_t payload_sizes[] = {1 << 10, 64 << 10, 1 << 20};
+
+std::string sized_path(std::size_t bytes) {
+  return "/products/" + std::to_string(bytes);
+}
+
+// Content-Encodings exercised by BM_FetchCompressed; index 0 is uncompressed
+const char* const encodings[] = {"identity", "gzip", "zstd", "br"};
+
+// compresses `text` with one of `encodings`, or returns an empty string if that codec is not compiled in
+std::string compress(const std::string& text, const std::string& encoding) {
+#if defined(JFETCH_WITH_ZLIB)
+  if (encoding == "gzip") {
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, text.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    stream.avail_in = static_cast<uInt>(text.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+  }
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+  if (encoding == "zstd") {
+    std::string out(ZSTD_compressBound(text.size()), '\0');
+    out.resize(ZSTD_compress(out.data(), out.size(), text.data(), text.size(), 3));
+    return out;
+  }
+#endif
+#if defined(JFETCH_WITH_BROTLI)
+  if (encoding == "br") {
+    std::size_t size = BrotliEncoderMaxCompressedSize(text.size());
+    std::string out(size, '\0');
+    BrotliEncoderCompress(5, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, text.size(),
+                          reinterpret_cast<const std::uint8_t*>(text.data()), &size,
+                          reinterpret_cast<std::uint8_t*>(out.data()));
+    out.resize(size);
+    return out;
+  }
+#endif
+  return encoding == "identity" ? text : std::string();
+}
+
+// wire formats exercised by BM_FetchFormat, in `jfetch::WireFormat` order
+const char* const formats[] = {"json", "cbor", "msgpack"};
+
+jfetch_mock::MockUpstream& server() {
+  static jfetch_mock::MockUpstream* instance = [] {
+    auto* s = new jfetch_mock::MockUpstream();
+    for (std::size_t bytes : payload_sizes) {
+      s->route(sized_path(bytes), jfetch_bench::products_payload(bytes));
+    }
+    std::string nested = jfetch_bench::nested_payload(64, 16);
+    s->route("/nested", nested);
+    s->route("/nested-arena", nested);
+
+    // long-tailed upstream: ~1 ms median with a log-normal tail
+    jfetch_mock::RouteSpec tail;
+    tail.body = jfetch_bench::products_payload(1 << 10);
+    tail.latency = jfetch_mock::Latency::lognormal(std::chrono::microseconds(1000), 0.8);
+    s->route("/tail", tail);
+
+    // flaky upstream: 5% 503s, 2% 429s, 1% connection resets, 1% truncated bodies
+    jfetch_mock::RouteSpec flaky;
+    flaky.body = jfetch_bench::products_payload(1 << 10);
+    flaky.statuses = {{200, 92}, {503, 5}, {429, 2}};
+    flaky.reset_probability = 0.01;
+    flaky.partial_probability = 0.01;
+    s->route("/flaky", flaky);
+
+    // the same 1 MiB payload pre-compressed with each codec
+    std::string large = jfetch_bench::products_payload(payload_sizes[2]);
+    for (const char* encoding : encodings) {
+      jfetch_mock::RouteSpec compressed;
+      compressed.body = compress(large, encoding);
+      compressed.content_encoding = std::string(encoding) == "identity" ? "" : encoding;
+      s->route(std::string("/compressed/") + encoding, compressed);
+    }
+
+    // the same 1 MiB payload as text JSON, CBOR and MessagePack
+    nlohmann::json document = nlohmann::json::parse(large);
+    for (const char* format : formats) {
+      jfetch_mock::RouteSpec binary;
+      std::string name = format;
+      std::vector<std::uint8_t> bytes = name == "cbor" ? nlohmann::json::to_cbor(document)
+                                      : name == "msgpack" ? nlohmann::json::to_msgpack(document)
+                                                          : std::vector<std::uint8_t>();
+      binary.body = name == "json" ? large : std::string(bytes.begin(), bytes.end());
+      binary.content_type = "application/" + name;
+      s->route("/format/" + name, binary);
+      s->route("/format-arena/" + name, binary);
+    }
+
+    // the 1 MiB payload decoded whole or through a JSON Pointer selection
+    for (const char* path : {"/select/full", "/select/pruned", "/select/pruned-arena"}) {
+      s->route(path, large);
+    }
+
+    // the products of the 1 MiB payload as one top-level array, decoded whole or element by element
+    std::string array = nlohmann::json::parse(large)["products"].dump();
+    s->route("/array", array);
+    s->route("/array-each", array);
+
+    // bulk-ingest sink for BM_PostCompressed; the mock discards request bodies
+    s->route("/ingest", R"({"products":[]})");
+
+    // the server is never destroyed, so remove its socket file at exit
+    static std::string socket_path = "/tmp/jfetch-bench-" + std::to_string(::getpid()) + ".sock";
+    s->listen_unix(socket_path);
+    std::atexit([] { ::unlink(socket_path.c_str()); });
+    s->start();
+    return s;
+  }();
+  return *instance;
+}
+
+class BenchFetcher : public jfetch::JFetch<std::size_t> {
+public:
+  explicit BenchFetcher(bool unix_socket = false)
+    : base_(server().base_url()), unix_socket_(unix_socket ? server().unix_socket() : "") {
+    for (std::size_t bytes : payload_sizes) {
+      endpoint_lookup[sized_path(bytes)] = {jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+        return json_data["products"].size();
+      }};
+    }
+    for (const char* path : {"/tail", "/flaky"}) {
+      endpoint_lookup[path] = {jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+        return json_data["products"].size();
+      }};
+    }
+    for (const char* encoding : encodings) {
+      jfetch::Endpoint<std::size_t> compressed{jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+        return json_data["products"].size();
+      }};
+      compressed.accept_compressed = true;
+      endpoint_lookup[std::string("/compressed/") + encoding] = compressed;
+    }
+    for (std::size_t i = 0; i < std::size(formats); ++i) {
+      jfetch::Endpoint<std::size_t> regular{jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+        return json_data["products"].size();
+      }};
+      jfetch::Endpoint<std::size_t> arena{jfetch::RequestMethod::GET, jfetch::with_arena([](const jfetch::ArenaJson& json_data) {
+        return json_data["products"].size();
+      })};
+      regular.format = arena.format = static_cast<jfetch::WireFormat>(i);
+      endpoint_lookup[std::string("/format/") + formats[i]] = regular;
+      endpoint_lookup[std::string("/format-arena/") + formats[i]] = arena;
+    }
+    // only the total and the first product's title are read
+    endpoint_lookup["/select/full"] = {jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+      return json_data["total"].get<std::size_t>() + json_data["products"][0]["title"].get_ref<const std::string&>().size();
+    }};
+    jfetch::Endpoint<std::size_t> pruned = endpoint_lookup["/select/full"];
+    pruned.select = {"/total", "/products/0/title"};
+    endpoint_lookup["/select/pruned"] = pruned;
+    jfetch::Endpoint<std::size_t> pruned_arena{jfetch::RequestMethod::GET, jfetch::with_arena([](const jfetch::ArenaJson& json_data) {
+      return json_data["total"].get<std::size_t>() + json_data["products"][0]["title"].get_ref<const jfetch::ArenaJson::string_t&>().size();
+    })};
+    pruned_arena.select = pruned.select;
+    endpoint_lookup["/select/pruned-arena"] = pruned_arena;
+    endpoint_lookup["/array"] = {jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+      std::size_t ids = 0;
+      for (const auto& product : json_data) {
+        ids += product["id"].get<std::size_t>();
+      }
+      return ids;
+    }};
+    endpoint_lookup["/array-each"] = {jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+      return json_data["id"].get<std::size_t>();
+    }};
+    endpoint_lookup["/nested"] = {jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
+      return json_data.size();
+    }};
+    endpoint_lookup["/nested-arena"] = {jfetch::RequestMethod::GET, jfetch::with_arena([](const jfetch::ArenaJson& json_data) {
+      return json_data.size();
+    })};
+  }
+
+protected:
+  std::string get_base() const override { return base_; }
+  std::string get_unix_socket() const override { return unix_socket_; }
+
+private:
+  std::string base_;
+  std::string unix_socket_;
+};
+
+void report_allocations(benchmark::State& state, std::size_t before) {
+  state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocations - before),
+                                                benchmark::Counter::kAvgIterations);
+}
+
+// end-to-end fetch() latency per payload size
+void BM_Fetch(benchmark::State& state) {
+  std::size_t bytes = payload_sizes[state.range(0)];
+  std::string path = sized_path(bytes);
+  BenchFetcher fetcher;
+
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path));
+  }
+  report_allocations(state, before);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.SetLabel(std::to_string(bytes >> 10) + " KiB");
+}
+BENCHMARK(BM_Fetch)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+// aggregate throughput with N threads, each using its own fetcher
+void BM_FetchThreads(benchmark::State& state) {
+  std::string path = sized_path(payload_sizes[0]);
+  BenchFetcher fetcher;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FetchThreads)->ThreadRange(1, 8)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// regular DOM versus arena-backed DOM on a deeply nested payload, end to end
+void BM_FetchNested(benchmark::State& state) {
+  std::string path = state.range(0) ? "/nested-arena" : "/nested";
+  BenchFetcher fetcher;
+
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path));
+  }
+  report_allocations(state, before);
+  state.SetLabel(state.range(0) ? "arena" : "dom");
+}
+BENCHMARK(BM_FetchNested)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+void report_latency(benchmark::State& state, const BenchFetcher& fetcher, const std::string& path) {
+  for (const auto& endpoint : fetcher.metrics_snapshot()) {
+    if (endpoint.endpoint == path) {
+      state.counters["p50_us"] = static_cast<double>(endpoint.latency.p50);
+      state.counters["p99_us"] = static_cast<double>(endpoint.latency.p99);
+      state.counters["p999_us"] = static_cast<double>(endpoint.latency.p999);
+      state.counters["error_rate"] = endpoint.error_rate;
+    }
+  }
+}
+
+// tail latency against a log-normal upstream; the mock's seeded RNG makes runs reproducible
+void BM_FetchTail(benchmark::State& state) {
+  BenchFetcher fetcher;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch("/tail"));
+  }
+  report_latency(state, fetcher, "/tail");
+}
+BENCHMARK(BM_FetchTail)->Iterations(500)->Unit(benchmark::kMicrosecond);
+
+// cost of the error paths: non-2xx statuses, resets and truncated bodies through try_fetch()
+void BM_FetchFlaky(benchmark::State& state) {
+  BenchFetcher fetcher;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.try_fetch("/flaky"));
+  }
+  report_latency(state, fetcher, "/flaky");
+}
+BENCHMARK(BM_FetchFlaky)->Iterations(2000)->Unit(benchmark::kMicrosecond);
+
+#ifdef JFETCH_BENCH_URING
+// libcurl versus the io_uring transport on a small keep-alive payload, where per-transfer overhead dominates
+void BM_FetchTransport(benchmark::State& state) {
+  std::string path = sized_path(payload_sizes[0]);
+  BenchFetcher fetcher;
+  if (state.range(0)) {
+    if (!jfetch::UringTransport::supported()) {
+      state.SkipWithError("io_uring unavailable");
+      return;
+    }
+    fetcher.set_transport(std::make_shared<jfetch::UringTransport>());
+  }
+
+  jfetch::FetchStats stats;
+  std::size_t reused = 0;
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path, {}, {}, "", &stats));
+    reused += stats.connection_reused;
+  }
+  report_allocations(state, before);
+  state.counters["reused"] = benchmark::Counter(static_cast<double>(reused), benchmark::Counter::kAvgIterations);
+  state.SetLabel(state.range(0) ? "io_uring" : "curl");
+}
+BENCHMARK(BM_FetchTransport)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+#endif
+
+// small JSON responses over TCP loopback versus a Unix domain socket, for each transport
+void BM_FetchUnixSocket(benchmark::State& state) {
+  std::string path = sized_path(payload_sizes[0]);
+  BenchFetcher fetcher(state.range(0) != 0);
+#ifdef JFETCH_BENCH_URING
+  if (state.range(1)) {
+    if (!jfetch::UringTransport::supported()) {
+      state.SkipWithError("io_uring unavailable");
+      return;
+    }
+    fetcher.set_transport(std::make_shared<jfetch::UringTransport>());
+  }
+#else
+  if (state.range(1)) {
+    state.SkipWithError("io_uring unavailable");
+    return;
+  }
+#endif
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path));
+  }
+  state.SetLabel(std::string(state.range(0) ? "uds" : "tcp") + (state.range(1) ? "/io_uring" : "/curl"));
+}
+BENCHMARK(BM_FetchUnixSocket)->Args({0, 0})->Args({1, 0})->Args({0, 1})->Args({1, 1})->Unit(benchmark::kMicrosecond);
+
+// 1 MiB of JSON sent uncompressed versus gzip, zstd and brotli, decoded while streaming
+void BM_FetchCompressed(benchmark::State& state) {
+  std::string encoding = encodings[state.range(0)];
+  std::string path = "/compressed/" + encoding;
+  if (compress("{}", encoding).empty()) {
+    state.SkipWithError((encoding + " codec not compiled in").c_str());
+    return;
+  }
+  BenchFetcher fetcher;
+
+  jfetch::FetchStats stats;
+  std::chrono::microseconds decompress{0};
+  std::size_t wire_bytes = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path, {}, {}, "", &stats));
+    decompress += stats.decompress;
+    wire_bytes += stats.body_bytes;
+  }
+  state.counters["decompress_us"] = benchmark::Counter(static_cast<double>(decompress.count()),
+                                                       benchmark::Counter::kAvgIterations);
+  state.counters["wire_bytes"] = benchmark::Counter(static_cast<double>(wire_bytes), benchmark::Counter::kAvgIterations);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * payload_sizes[2]));
+  state.SetLabel(encoding);
+}
+BENCHMARK(BM_FetchCompressed)->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+
+// the 1 MiB payload as text JSON, CBOR and MessagePack, parsed into the regular or the arena DOM
+void BM_FetchFormat(benchmark::State& state) {
+  std::string format = formats[state.range(0)];
+  bool arena = state.range(1) == 1;
+  std::string path = (arena ? "/format-arena/" : "/format/") + format;
+  BenchFetcher fetcher;
+
+  jfetch::FetchStats stats;
+  std::chrono::microseconds parse{0};
+  std::size_t wire_bytes = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path, {}, {}, "", &stats));
+    parse += stats.parse;
+    wire_bytes += stats.body_bytes;
+  }
+  state.counters["parse_us"] = benchmark::Counter(static_cast<double>(parse.count()), benchmark::Counter::kAvgIterations);
+  state.counters["wire_bytes"] = benchmark::Counter(static_cast<double>(wire_bytes), benchmark::Counter::kAvgIterations);
+  state.SetLabel(format + (arena ? " arena" : ""));
+}
+BENCHMARK(BM_FetchFormat)->ArgsProduct({{0, 1, 2}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+// the 1 MiB payload when the endpoint reads two values: full DOM versus a pruned DOM, regular and arena
+void BM_FetchSelected(benchmark::State& state) {
+  static const char* const paths[] = {"/select/full", "/select/pruned", "/select/pruned-arena"};
+  std::string path = paths[state.range(0)];
+  BenchFetcher fetcher;
+
+  jfetch::FetchStats stats;
+  std::chrono::microseconds parse{0};
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch(path, {}, {}, "", &stats));
+    parse += stats.parse;
+  }
+  report_allocations(state, before);
+  state.counters["parse_us"] = benchmark::Counter(static_cast<double>(parse.count()), benchmark::Counter::kAvgIterations);
+  state.SetLabel(path.substr(8));
+}
+BENCHMARK(BM_FetchSelected)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+// a ~1 MiB top-level array: fetch() builds the whole DOM, fetch_each() one element at a time;
+// first_us is the time until the first element reaches the caller, peak_kib the heap high-water mark of a call
+void BM_FetchEach(benchmark::State& state) {
+  bool each = state.range(0) == 1;
+  BenchFetcher fetcher;
+
+  std::chrono::nanoseconds first{0};
+  long long peak = 0;
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    peak_bytes = live_bytes;
+    long long baseline = live_bytes;
+    auto started = std::chrono::steady_clock::now();
+    std::size_t ids = 0;
+    if (each) {
+      fetcher.fetch_each("/array-each", [&](std::size_t id) {
+        if (ids == 0) {
+          first += std::chrono::steady_clock::now() - started;
+        }
+        ids += id;
+      });
+    } else {
+      ids = fetcher.fetch("/array");
+      first += std::chrono::steady_clock::now() - started;
+    }
+    benchmark::DoNotOptimize(ids);
+    peak = std::max(peak, peak_bytes - baseline);
+  }
+  report_allocations(state, before);
+  state.counters["peak_kib"] = static_cast<double>(peak) / 1024.0;
+  state.counters["first_us"] = benchmark::Counter(static_cast<double>(first.count()) / 1000.0,
+                                                  benchmark::Counter::kAvgIterations);
+  state.SetLabel(each ? "fetch_each" : "fetch");
+}
+BENCHMARK(BM_FetchEach)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// 1 MiB JSON request bodies sent uncompressed versus gzip and zstd at a fast, the default and a dense level
+void BM_PostCompressed(benchmark::State& state) {
+  static const jfetch::BodyEncoding codecs[] = {jfetch::BodyEncoding::Identity, jfetch::BodyEncoding::Gzip,
+                                                jfetch::BodyEncoding::Zstd};
+  jfetch::RequestCompression compression;
+  compression.encoding = codecs[state.range(0)];
+  compression.level = static_cast<int>(state.range(1));
+  if (compression.encoding != jfetch::BodyEncoding::Identity && !jfetch::ContentEncoder::supported(compression.encoding)) {
+    state.SkipWithError((std::string(jfetch::ContentEncoder::name(compression.encoding)) + " codec not compiled in").c_str());
+    return;
+  }
+
+  BenchFetcher fetcher;
+  jfetch::Endpoint<std::size_t> ingest{jfetch::RequestMethod::POST, [](const nlohmann::json& json_data) {
+    return json_data["products"].size();
+  }};
+  ingest.request_compression = compression;
+  fetcher.set_endpoint("/ingest", ingest);
+  std::string body = jfetch_bench::products_payload(payload_sizes[2]);
+
+  jfetch::FetchStats stats;
+  std::chrono::microseconds compress{0};
+  std::size_t wire_bytes = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.fetch("/ingest", {}, {}, body, &stats));
+    compress += stats.compress;
+    wire_bytes += stats.request_bytes;
+  }
+  state.counters["compress_us"] = benchmark::Counter(static_cast<double>(compress.count()),
+                                                     benchmark::Counter::kAvgIterations);
+  state.counters["wire_bytes"] = benchmark::Counter(static_cast<double>(wire_bytes), benchmark::Counter::kAvgIterations);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * body.size()));
+  state.SetLabel(jfetch::ContentEncoder::name(compression.encoding));
+}
+BENCHMARK(BM_PostCompressed)
+    ->Args({0, 0})
+    ->Args({1, 1})->Args({1, 0})->Args({1, 9})
+    ->Args({2, 1})->Args({2, 0})->Args({2, 9})
+    ->Unit(benchmark::kMicrosecond);
+
+// 64 KiB JSON request bodies: dump() into a fresh string versus serializing into a pooled buffer,
+// uncompressed and zstd-compressed (the compressed copy is pooled too)
+void BM_PostJson(benchmark::State& state) {
+  bool pooled = state.range(0) == 1;
+  bool compressed = state.range(1) == 1;
+  if (compressed && !jfetch::ContentEncoder::supported(jfetch::BodyEncoding::Zstd)) {
+    state.SkipWithError("zstd codec not compiled in");
+    return;
+  }
+  BenchFetcher fetcher;
+  jfetch::Endpoint<std::size_t> ingest{jfetch::RequestMethod::POST, [](const nlohmann::json& json_data) {
+    return json_data["products"].size();
+  }};
+  if (compressed) {
+    ingest.request_compression.encoding = jfetch::BodyEncoding::Zstd;
+  }
+  fetcher.set_endpoint("/ingest", ingest);
+  nlohmann::json document = nlohmann::json::parse(jfetch_bench::products_payload(payload_sizes[1]));
+
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    if (pooled) {
+      benchmark::DoNotOptimize(fetcher.fetch("/ingest", {}, {}, document));
+    } else {
+      benchmark::DoNotOptimize(fetcher.fetch("/ingest", {}, {}, document.dump()));
+    }
+  }
+  report_allocations(state, before);
+  state.SetLabel(std::string(pooled ? "pooled" : "dump") + (compressed ? " zstd" : ""));
+}
+BENCHMARK(BM_PostJson)->ArgsProduct({{0, 1}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+// batches of fetch_async() decoded on a work-stealing pool of N workers while the reactor keeps reading
+void BM_FetchAsync(benchmark::State& state) {
+  constexpr std::size_t batch = 32;
+  std::string path = sized_path(payload_sizes[1]);
+  auto executor = std::make_shared<jfetch::WorkStealingExecutor>(static_cast<std::size_t>(state.range(0)));
+  BenchFetcher fetcher;
+  fetcher.set_executor(executor);
+
+  std::vector<std::future<std::size_t>> pending;
+  pending.reserve(batch);
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < batch; ++i) {
+      pending.push_back(fetcher.fetch_async(path));
+    }
+    for (auto& result : pending) {
+      benchmark::DoNotOptimize(result.get());
+    }
+    pending.clear();
+  }
+
+  jfetch::ExecutorStats stats = executor->stats();
+  state.counters["steals"] = benchmark::Counter(static_cast<double>(stats.steals), benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * batch));
+}
+BENCHMARK(BM_FetchAsync)->RangeMultiplier(2)->Range(1, 4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+jfetch::ChunkedBuffer rope_of(const std::string& text) {
+  jfetch::ChunkedBuffer rope;
+  rope.append(text.data(), text.size());
+  return rope;
+}
+
+// parse throughput from a contiguous string
+void BM_ParseString(benchmark::State& state) {
+  std::string text = jfetch_bench::products_payload(payload_sizes[state.range(0)]);
+
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(nlohmann::json::parse(text));
+  }
+  report_allocations(state, before);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+BENCHMARK(BM_ParseString)->DenseRange(0, 2);
+
+// parse throughput straight from the chunked rope fetch() uses
+void BM_ParseRope(benchmark::State& state) {
+  jfetch::ChunkedBuffer rope = rope_of(jfetch_bench::products_payload(payload_sizes[state.range(0)]));
+
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(nlohmann::json::parse(rope.begin(), rope.end()));
+  }
+  report_allocations(state, before);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * rope.size()));
+}
+BENCHMARK(BM_ParseRope)->DenseRange(0, 2);
+
+// parse from the rope into an arena-backed DOM released in one shot
+void BM_ParseRopeArena(benchmark::State& state) {
+  jfetch::ChunkedBuffer rope = rope_of(jfetch_bench::products_payload(payload_sizes[state.range(0)]));
+
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    std::pmr::monotonic_buffer_resource arena(rope.size() * 2 + 4096);
+    jfetch::ArenaScope scope(&arena);
+    alignas(jfetch::ArenaJson) unsigned char storage[sizeof(jfetch::ArenaJson)];
+    auto* json_data = ::new (storage) jfetch::ArenaJson(jfetch::ArenaJson::parse(rope.begin(), rope.end()));
+    benchmark::DoNotOptimize(json_data);
+  }
+  report_allocations(state, before);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * rope.size()));
+}
+BENCHMARK(BM_ParseRopeArena)->DenseRange(0, 2);
+
+// hand-written per-key lookups versus the FIELDS-generated decoder on an already parsed 1 MiB DOM
+jfetch_bench::Catalog decode_by_hand(const nlohmann::json& json_data) {
+  jfetch_bench::Catalog catalog;
+  for (const auto& item : json_data["products"]) {
+    jfetch_bench::Product product;
+    product.id = item["id"].get<int>();
+    product.title = item["title"].get<std::string>();
+    product.description = item["description"].get<std::string>();
+    product.price = item["price"].get<double>();
+    product.rating = item["rating"].get<double>();
+    product.tags = item["tags"].get<std::vector<std::string>>();
+    const auto& dimensions = item["dimensions"];
+    product.dimensions = {dimensions["width"].get<double>(), dimensions["height"].get<double>(),
+                          dimensions["depth"].get<double>()};
+    for (const auto& review : item["reviews"]) {
+      product.reviews.push_back({review["rating"].get<int>(), review["comment"].get<std::string>(),
+                                 review["reviewer"].get<std::string>()});
+    }
+    catalog.products.push_back(std::move(product));
+  }
+  catalog.total = json_data["total"].get<int>();
+  return catalog;
+}
+
+void BM_DecodeMapped(benchmark::State& state) {
+  bool mapped = state.range(0) == 1;
+  nlohmann::json document = nlohmann::json::parse(jfetch_bench::products_payload(payload_sizes[2]));
+  auto decoder = jfetch::mapped_decoder<jfetch_bench::Catalog>();
+
+  std::size_t before = allocations;
+  for (auto _ : state) {
+    jfetch_bench::Catalog catalog = mapped ? decoder(document) : decode_by_hand(document);
+    benchmark::DoNotOptimize(catalog.products.data());
+  }
+  report_allocations(state, before);
+  state.SetLabel(mapped ? "mapped" : "by hand");
+}
+BENCHMARK(BM_DecodeMapped)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
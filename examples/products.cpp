@@ -8,17 +8,14 @@ struct Product {
   double price;
 };
 
+// JSON key -> member mapping; the decoder below is generated from it
+JFETCH_FIELDS(Product, JFETCH_FIELD(id), JFETCH_FIELD(title), JFETCH_FIELD(price));
+
 class ProductFetcher : public jfetch::JFetch<Product> {
 public:
   ProductFetcher() {
     endpoint_lookup = {
-      {"/products/1", {jfetch::RequestMethod::GET, [](const nlohmann::json& json_data) {
-        return Product{
-          json_data["id"].get<int>(),
-          json_data["title"].get<std::string>(),
-          json_data["price"].get<double>()
-        };
-      }}},
+      {"/products/1", {jfetch::RequestMethod::GET, jfetch::mapped_decoder<Product>()}},
     };
   }
 
@@ -10,13 +10,98 @@
 #define JFETCH_HPP
 
 #include <string>
+#include <algorithm>
 #include <vector>
+#include <array>
 #include <unordered_map>
 #include <functional>
 #include <exception>
+#include <memory>
+#include <memory_resource>
+#include <map>
+#include <tuple>
+#include <stdexcept>
+#include <optional>
+#include <new>
+#include <type_traits>
+#include <variant>
+#include <string_view>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <thread>
+#include <cstdint>
+#include <chrono>
+#include <charconv>
+#include <iterator>
+#include <ostream>
+#include <streambuf>
+#include <utility>
+#include <cstring>
+#include <cstddef>
+#include <cctype>
+#include <cerrno>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 
+#if __has_include(<unistd.h>) && __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JFETCH_HAS_POSIX_IO 1
+#endif
+
+/**
+ * @def JFETCH_ENABLE_USDT
+ * @brief Define before including jfetch.hpp to compile SystemTap/USDT probes into the fetch path.
+ *
+ * Probes (provider `jfetch`) are single `nop` instructions until a tracer such
+ * as bpftrace or perf attaches to them:
+ * - `fetch__start(endpoint)` / `fetch__done(endpoint, http_status, latency_us, failed)`
+ * - `request__start(url)` / `request__done(url, curl_code, http_status)`
+ * - `write__chunk(bytes)`
+ * - `parse__start(bytes)` / `parse__done(bytes)`
+ *
+ * Requires `<sys/sdt.h>` (systemtap-sdt-dev); without it the probes expand to nothing.
+ */
+#if defined(JFETCH_ENABLE_USDT) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define JFETCH_PROBE1(name, a) DTRACE_PROBE1(jfetch, name, a)
+#define JFETCH_PROBE3(name, a, b, c) DTRACE_PROBE3(jfetch, name, a, b, c)
+#define JFETCH_PROBE4(name, a, b, c, d) DTRACE_PROBE4(jfetch, name, a, b, c, d)
+#else
+#define JFETCH_PROBE1(name, a) ((void)0)
+#define JFETCH_PROBE3(name, a, b, c) ((void)0)
+#define JFETCH_PROBE4(name, a, b, c, d) ((void)0)
+#endif
+
+/**
+ * @def JFETCH_WITH_ZLIB
+ * @brief Define (and link zlib) to decode gzip/deflate responses in JFetch itself.
+ * @def JFETCH_WITH_ZSTD
+ * @brief Define (and link libzstd) to decode zstd responses in JFetch itself.
+ * @def JFETCH_WITH_BROTLI
+ * @brief Define (and link libbrotlidec) to decode brotli responses in JFetch itself.
+ *
+ * With at least one of these, endpoints that accept compressed responses
+ * advertise exactly the compiled-in encodings and decode them while the body
+ * streams in, reporting the time in `FetchStats::decompress`. Without any,
+ * libcurl negotiates and decodes with whatever it was built with. zlib and
+ * libzstd also enable gzip/zstd request body compression (`RequestCompression`).
+ */
+#if defined(JFETCH_WITH_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(JFETCH_WITH_BROTLI)
+#include <brotli/decode.h>
+#endif
+
 namespace jfetch {
 
 /**
@@ -104,190 +189,4808 @@ public:
 };
 
 /**
- * @brief Internal class to handle HTTP transactions via libcurl.
+ * @brief Size-classed pool of request body buffers, shared by every thread in the process.
+ *
+ * Serialized JSON bodies and compressed bodies borrow from it. Buffers are
+ * bucketed by capacity in power-of-two classes (4 KiB to 64 MiB). Released
+ * buffers keep their capacity, so repeated large uploads stop reallocating
+ * and fragmenting the heap. Responses use `SlabAllocator` instead.
  */
-class HttpClient {
+class BufferPool {
 public:
+  static constexpr std::size_t min_class_shift = 12;  ///< Smallest class is 4 KiB
+  static constexpr std::size_t class_count = 15;      ///< Largest class is 64 MiB
+  static constexpr std::size_t max_per_class = 8;     ///< Buffers retained per class
+
   /**
-   * @brief Constructs a new HttpClient.
-   * @param url Target URL for the HTTP request.
-   * @param method HTTP method to use.
-   * @param headers Optional HTTP headers.
-   * @param body Optional request body.
+   * @brief Returns the process-wide pool.
    */
-  HttpClient(const std::string& url,
-         RequestMethod method,
-         const std::vector<std::string>& headers = {},
-         const std::string& body = "")
-    : url_(url), method_(method), headers_(headers), body_(body) {}
+  static BufferPool& instance() {
+    static BufferPool pool;
+    return pool;
+  }
 
   /**
-   * @brief Performs the HTTP request and stores the response.
-   * @param response String to receive the response body.
-   * @return `true` on success, throws on failure.
+   * @brief Takes an empty buffer with at least `size_hint` bytes of capacity.
+   * @param size_hint Expected number of bytes (0 if unknown).
    */
-  bool perform_request(std::string& response) const {
-    std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl(curl_easy_init(), curl_easy_cleanup);
-    if (!curl) {
-      throw JFetchException("Failed to initialize CURL");
+  std::string acquire(std::size_t size_hint = 0) {
+    std::string buffer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (std::size_t i = class_for(size_hint); i < class_count; ++i) {
+        if (!classes_[i].empty()) {
+          buffer = std::move(classes_[i].back());
+          classes_[i].pop_back();
+          break;
+        }
+      }
     }
+    buffer.reserve(size_hint);
+    return buffer;
+  }
 
-    curl_easy_setopt(curl.get(), CURLOPT_URL, url_.c_str());
-    curl_easy_setopt(curl.get(), CURLOPT_CUSTOMREQUEST, method_to_string().c_str());
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, 10L);
+  /**
+   * @brief Returns a buffer to the pool; oversized buffers are freed.
+   * @param buffer Buffer to recycle (contents are discarded).
+   */
+  void release(std::string&& buffer) {
+    std::size_t capacity = buffer.capacity();
+    if (capacity < class_size(0) || capacity > class_size(class_count - 1)) {
+      return;
+    }
 
-    struct curl_slist* header_list = nullptr;
-    for (const auto& header : headers_) {
-      header_list = curl_slist_append(header_list, header.c_str());
+    // bucket by the largest class the buffer fully covers
+    std::size_t index = class_for(capacity);
+    if (class_size(index) > capacity) {
+      --index;
     }
-    curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, header_list);
 
-    if (!body_.empty() &&
-      (method_ == RequestMethod::POST ||
-       method_ == RequestMethod::PUT ||
-       method_ == RequestMethod::PATCH)) {
-      curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, body_.c_str());
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (classes_[index].size() < max_per_class) {
+      classes_[index].push_back(std::move(buffer));
     }
+  }
 
-    CURLcode res = curl_easy_perform(curl.get());
-    long http_status;
-    curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &http_status);
-    curl_slist_free_all(header_list);
+private:
+  std::mutex mutex_;
+  std::array<std::vector<std::string>, class_count> classes_;
 
-    if (res != CURLE_OK) {
-      throw JFetchHTTPException(http_status, curl_easy_strerror(res));
-    }
+  static constexpr std::size_t class_size(std::size_t index) {
+    return std::size_t{1} << (min_class_shift + index);
+  }
 
-    if (http_status < 200 || http_status >= 300) {
-      throw JFetchHTTPException(http_status, "Unexpected HTTP status code");
+  static std::size_t class_for(std::size_t size) {
+    std::size_t index = 0;
+    while (index + 1 < class_count && class_size(index) < size) {
+      ++index;
     }
+    return index;
+  }
+};
 
-    return true;
+/**
+ * @brief Allocator handing out fixed-size chunks for `ChunkedBuffer`.
+ *
+ * Each thread keeps up to `thread_cache_chunks` free chunks of its own, so a
+ * steady stream of fetches takes no lock. The cache refills from and spills
+ * into a shared free list in batches; that list keeps at most
+ * `max_free_chunks` and returns the rest to the heap, so one very large
+ * response does not pin its peak memory for the rest of the process.
+ * Chunks are interchangeable: any thread may release a chunk taken by another.
+ */
+class SlabAllocator {
+public:
+  static constexpr std::size_t chunk_size = 16 * 1024;      ///< Bytes per chunk (matches libcurl's write size)
+  static constexpr std::size_t thread_cache_chunks = 64;    ///< Free chunks kept per thread (1 MiB)
+  static constexpr std::size_t max_free_chunks = 256;       ///< Free chunks kept in the shared list (4 MiB)
+
+  SlabAllocator() { free_.reserve(max_free_chunks); }
+
+  SlabAllocator(const SlabAllocator&) = delete;
+  SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+  ~SlabAllocator() {
+    for (char* chunk : free_) {
+      delete[] chunk;
+    }
   }
 
-private:
-  std::string url_;
-  RequestMethod method_;
-  std::vector<std::string> headers_;
-  std::string body_;
+  /**
+   * @brief Returns the process-wide allocator.
+   */
+  static SlabAllocator& instance() {
+    static SlabAllocator allocator;
+    return allocator;
+  }
 
   /**
-   * @brief Converts the enum method to a string.
+   * @brief Returns a chunk of `chunk_size` bytes.
    */
-  std::string method_to_string() const {
-    switch (method_) {
-      case RequestMethod::GET: return "GET";
-      case RequestMethod::POST: return "POST";
-      case RequestMethod::PUT: return "PUT";
-      case RequestMethod::DEL: return "DELETE";
-      case RequestMethod::PATCH: return "PATCH";
-      default: return "GET";
+  char* allocate() {
+    ThreadCache* cache = thread_cache();
+    if (!cache) {
+      char* chunk = nullptr;
+      return refill(&chunk, 1) ? chunk : new char[chunk_size];
+    }
+    if (cache->count == 0) {
+      cache->count = refill(cache->chunks.data(), thread_cache_chunks / 2);
+      if (cache->count == 0) {
+        return new char[chunk_size];
+      }
     }
+    return cache->chunks[--cache->count];
   }
 
   /**
-   * @brief Callback for libcurl to write response data.
+   * @brief Returns a chunk for reuse, or to the heap once the caches are full.
+   * @param chunk Chunk previously obtained from `allocate()`.
    */
-  static size_t write_callback(void* contents, size_t size, size_t nmemb, std::string* user_data) {
-    user_data->append(static_cast<char*>(contents), size * nmemb);
-    return size * nmemb;
+  void deallocate(char* chunk) {
+    ThreadCache* cache = thread_cache();
+    if (!cache) {
+      spill(&chunk, 1);
+      return;
+    }
+    if (cache->count == thread_cache_chunks) {
+      // keep the newer half hot in this thread, hand the older half on
+      spill(cache->chunks.data(), thread_cache_chunks / 2);
+      std::move(cache->chunks.begin() + thread_cache_chunks / 2, cache->chunks.end(), cache->chunks.begin());
+      cache->count -= thread_cache_chunks / 2;
+    }
+    cache->chunks[cache->count++] = chunk;
+  }
+
+private:
+  struct ThreadCache {
+    std::array<char*, thread_cache_chunks> chunks;
+    std::size_t count = 0;
+    bool& destroyed;
+
+    explicit ThreadCache(bool& destroyed) : destroyed(destroyed) {}
+
+    ~ThreadCache() {
+      instance().spill(chunks.data(), count);
+      destroyed = true;
+    }
+  };
+
+  std::mutex mutex_;
+  std::vector<char*> free_;
+
+  // this thread's cache, or `nullptr` once thread exit has destroyed it
+  static ThreadCache* thread_cache() {
+    static thread_local bool destroyed = false;
+    if (destroyed) {
+      return nullptr;
+    }
+    static thread_local ThreadCache cache(destroyed);
+    return &cache;
+  }
+
+  // moves up to `count` shared chunks into `chunks`, returning how many
+  std::size_t refill(char** chunks, std::size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t taken = std::min(count, free_.size());
+    std::copy(free_.end() - static_cast<std::ptrdiff_t>(taken), free_.end(), chunks);
+    free_.resize(free_.size() - taken);
+    return taken;
+  }
+
+  // adds chunks to the shared list, freeing whatever does not fit
+  void spill(char** chunks, std::size_t count) {
+    std::size_t kept = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (; kept < count && free_.size() < max_free_chunks; ++kept) {
+        free_.push_back(chunks[kept]);
+      }
+    }
+    for (; kept < count; ++kept) {
+      delete[] chunks[kept];
+    }
   }
 };
 
 /**
- * @brief Main template class for interfacing with JSON HTTP endpoints.
- * @tparam T The return type expected after JSON processing.
+ * @brief Response body stored as a rope of fixed-size slab chunks.
+ *
+ * Appending never moves existing bytes, and `begin()`/`end()` expose a forward
+ * iterator that `nlohmann::json::parse` consumes directly across chunk
+ * boundaries, so the body is never coalesced into one contiguous string.
  */
-template <typename T>
-class JFetch {
+class ChunkedBuffer {
 public:
   /**
-   * @brief Virtual Destructor
+   * @brief Forward iterator over the buffered bytes.
    */
-  virtual ~JFetch() = default;
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char*;
+    using reference = const char&;
+
+    const_iterator() = default;
+
+    reference operator*() const { return chunks_[index_][offset_]; }
+
+    const_iterator& operator++() {
+      if (++offset_ == SlabAllocator::chunk_size) {
+        ++index_;
+        offset_ = 0;
+      }
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return index_ == other.index_ && offset_ == other.offset_;
+    }
+
+    bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+  private:
+    friend class ChunkedBuffer;
+
+    const_iterator(char* const* chunks, std::size_t index, std::size_t offset)
+      : chunks_(chunks), index_(index), offset_(offset) {}
+
+    char* const* chunks_ = nullptr;
+    std::size_t index_ = 0;
+    std::size_t offset_ = 0;
+  };
 
   /**
-   * @brief Sends/Fetches a request to a specified endpoint and parses the JSON response into `T`.
-   *
-   * @param endpoint Name of the registered endpoint.
-   * @param query_params Optional URL query parameters.
-   * @param custom_headers Optional headers specific to this request.
-   * @param custom_body Optional body payload.
-   * @return Parsed object of type `T`.
-   *
-   * @throws JFetchException On initialization or CURL failure.
-   * @throws JFetchHTTPException On HTTP error response.
-   * @throws JFetchParsingException On JSON parse failure.
-   * @throws JFetchEndpointNotFoundException If endpoint isn't registered.
+   * @brief Constructs an empty buffer.
+   * @param allocator Source of chunks.
    */
-  T fetch(const std::string& endpoint,
-      const std::unordered_map<std::string, std::string>& query_params = {},
-      const std::vector<std::string>& custom_headers = {},
-      const std::string& custom_body = "") {
-    std::string raw_json;
+  explicit ChunkedBuffer(SlabAllocator& allocator = SlabAllocator::instance())
+    : allocator_(&allocator) {}
 
-    // construct the full URL with query parameters
-    std::string full_url = get_base() + endpoint;
-    if (!query_params.empty()) {
-      full_url += "?";
-      for (const auto& [key, value] : query_params) {
-        full_url += key + "=" + value + "&";
+  ChunkedBuffer(const ChunkedBuffer&) = delete;
+  ChunkedBuffer& operator=(const ChunkedBuffer&) = delete;
+
+  ChunkedBuffer(ChunkedBuffer&& other) noexcept
+    : allocator_(other.allocator_), chunks_(std::move(other.chunks_)), size_(other.size_) {
+    other.chunks_.clear();
+    other.size_ = 0;
+  }
+
+  ChunkedBuffer& operator=(ChunkedBuffer&& other) noexcept {
+    if (this != &other) {
+      clear();
+      allocator_ = other.allocator_;
+      chunks_ = std::move(other.chunks_);
+      size_ = other.size_;
+      other.chunks_.clear();
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  ~ChunkedBuffer() { clear(); }
+
+  /**
+   * @brief Appends bytes, taking new chunks as needed.
+   */
+  void append(const char* data, std::size_t length) {
+    while (length > 0) {
+      std::size_t offset = size_ % SlabAllocator::chunk_size;
+      if (offset == 0 && size_ / SlabAllocator::chunk_size == chunks_.size()) {
+        chunks_.push_back(allocator_->allocate());
       }
-      full_url.pop_back();  // remove the trailing '&'
+      std::size_t count = std::min(length, SlabAllocator::chunk_size - offset);
+      std::memcpy(chunks_.back() + offset, data, count);
+      size_ += count;
+      data += count;
+      length -= count;
+    }
+  }
+
+  /**
+   * @brief Pre-sizes the chunk table for `bytes` total bytes (chunks are still taken lazily).
+   */
+  void reserve(std::size_t bytes) {
+    chunks_.reserve((bytes + SlabAllocator::chunk_size - 1) / SlabAllocator::chunk_size);
+  }
+
+  /**
+   * @brief Returns every chunk to the allocator.
+   */
+  void clear() {
+    for (char* chunk : chunks_) {
+      allocator_->deallocate(chunk);
     }
+    chunks_.clear();
+    size_ = 0;
+  }
 
-    // combine global and custom headers
-    std::vector<std::string> headers = global_headers;
-    headers.insert(headers.end(), custom_headers.begin(), custom_headers.end());
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
 
-    // use the provided body, otherwise fallback to the default body
-    std::string body = custom_body.empty() ? get_body() : custom_body;
+  const_iterator begin() const { return const_iterator(chunks_.data(), 0, 0); }
 
-    // get request method from the endpoint lookup table
-    if (endpoint_lookup.find(endpoint) == endpoint_lookup.end()) {
-      throw JFetchEndpointNotFoundException(endpoint);
+  const_iterator end() const {
+    return const_iterator(chunks_.data(), size_ / SlabAllocator::chunk_size, size_ % SlabAllocator::chunk_size);
+  }
+
+  /**
+   * @brief Invokes `visitor(const char*, std::size_t)` for each contiguous segment.
+   */
+  template <typename Visitor>
+  void for_each_segment(Visitor&& visitor) const {
+    std::size_t remaining = size_;
+    for (char* chunk : chunks_) {
+      std::size_t count = std::min(remaining, SlabAllocator::chunk_size);
+      visitor(static_cast<const char*>(chunk), count);
+      remaining -= count;
     }
+  }
+
+  /**
+   * @brief Copies the contents into a contiguous string.
+   */
+  std::string to_string() const {
+    std::string result;
+    result.reserve(size_);
+    for_each_segment([&result](const char* data, std::size_t length) { result.append(data, length); });
+    return result;
+  }
+
+private:
+  SlabAllocator* allocator_;
+  std::vector<char*> chunks_;
+  std::size_t size_ = 0;
+};
 
-    const auto& [method, lambda] = endpoint_lookup.at(endpoint);
+/**
+ * @brief Serialization of a response body; see `Endpoint::format`.
+ */
+enum class WireFormat {
+  Json,     ///< `application/json` (and anything unrecognised)
+  Cbor,     ///< `application/cbor`
+  MsgPack,  ///< `application/msgpack`, `application/x-msgpack` or `application/vnd.msgpack`
+};
 
-    HttpClient client(full_url, method, headers, body);
-    client.perform_request(raw_json);
+/**
+ * @brief Maps a `Content-Type` header value to the format it names.
+ */
+inline WireFormat wire_format_of(std::string_view content_type) {
+  std::string_view media = content_type.substr(0, content_type.find(';'));
+  while (!media.empty() && (media.back() == ' ' || media.back() == '\t')) media.remove_suffix(1);
+  auto is = [media](std::string_view name) {
+    return media.size() == name.size() &&
+           std::equal(media.begin(), media.end(), name.begin(), [](char a, char b) {
+             return std::tolower(static_cast<unsigned char>(a)) == b;
+           });
+  };
+  if (is("application/cbor")) {
+    return WireFormat::Cbor;
+  }
+  if (is("application/msgpack") || is("application/x-msgpack") || is("application/vnd.msgpack")) {
+    return WireFormat::MsgPack;
+  }
+  return WireFormat::Json;
+}
 
-    auto json_data = nlohmann::json::parse(raw_json);
-    return lambda(json_data);
+/**
+ * @brief Returns the `Accept` header preferring `format`, with JSON as the fallback.
+ */
+inline const char* accept_header(WireFormat format) {
+  switch (format) {
+    case WireFormat::Cbor: return "Accept: application/cbor, application/json;q=0.5";
+    case WireFormat::MsgPack: return "Accept: application/msgpack, application/x-msgpack, application/json;q=0.5";
+    default: return "Accept: application/json";
   }
+}
+
+/**
+ * @brief Outcome of a single HTTP transfer, reported without throwing.
+ */
+struct TransferResult {
+  CURLcode curl_code = CURLE_OK;         ///< libcurl result code
+  long http_status = 0;                  ///< HTTP status code (0 if no response was received)
+  WireFormat format = WireFormat::Json;  ///< Body format named by the response's `Content-Type`
 
   /**
-   * @brief Sets global headers applied to all requests.
-   * @param headers List of HTTP headers.
+   * @brief Returns `true` when the transfer completed with a 2xx status.
    */
-  void set_global_headers(const std::vector<std::string>& headers) {
-    global_headers = headers;
+  bool ok() const {
+    return curl_code == CURLE_OK && http_status >= 200 && http_status < 300;
   }
+};
 
-protected:
+/**
+ * @brief Category of a `FetchError`.
+ */
+enum class FetchErrorCode {
+  EndpointNotFound,  ///< Endpoint missing from the lookup table
+  CurlInit,          ///< libcurl handle could not be created
+  Transport,         ///< libcurl transfer failure (DNS, connect, timeout, ...)
+  HttpStatus,        ///< Response with a non-2xx status code
+  Parse,             ///< Response body is not valid JSON, or the decoder reported a parsing error
+  Decode,            ///< Decoder threw any other exception
+};
+
+/**
+ * @brief Structured error returned by `JFetch::try_fetch()`.
+ *
+ * Transfer and status errors store only codes; the message is formatted on
+ * demand by `message()`, so high rates of 4xx/5xx responses cost no string work.
+ */
+class FetchError {
+public:
   /**
-   * @brief Returns the base URL for all requests.
-   * @return Base URL as a string.
+   * @brief Error for an endpoint missing from the lookup table.
    */
-  virtual std::string get_base() const = 0;
+  static FetchError endpoint_not_found(const std::string& endpoint) {
+    FetchError error(FetchErrorCode::EndpointNotFound);
+    error.endpoint_ = endpoint;
+    return error;
+  }
+
   /**
-   * @brief Returns a default request body.
-   * @return Body string (default is empty).
+   * @brief Error for a failed transfer or non-2xx status.
    */
-  virtual std::string get_body() const { return ""; }
+  static FetchError from_transfer(const TransferResult& result) {
+    FetchError error(result.curl_code == CURLE_FAILED_INIT ? FetchErrorCode::CurlInit :
+                     result.curl_code != CURLE_OK ? FetchErrorCode::Transport : FetchErrorCode::HttpStatus);
+    error.curl_code_ = result.curl_code;
+    error.http_status_ = result.http_status;
+    return error;
+  }
 
   /**
-   * @brief User-defined mapping of endpoints to their HTTP method and parsing logic.
+   * @brief Error wrapping an exception thrown while parsing or decoding.
    */
-  std::unordered_map<std::string, std::pair<RequestMethod, std::function<T(const nlohmann::json&)>>> endpoint_lookup;
+  static FetchError from_exception(FetchErrorCode code, std::exception_ptr cause) {
+    FetchError error(code);
+    error.cause_ = std::move(cause);
+    return error;
+  }
+
+  FetchErrorCode code() const { return code_; }
+  long http_status() const { return http_status_; }
+  CURLcode curl_code() const { return curl_code_; }
+
   /**
-   * @brief List of global HTTP headers applied to all requests.
+   * @brief Formats the error; identical to `what()` of the exception `raise()` throws.
    */
-  std::vector<std::string> global_headers;
+  std::string message() const {
+    switch (code_) {
+      case FetchErrorCode::EndpointNotFound:
+        return JFetchEndpointNotFoundException(endpoint_).what();
+      case FetchErrorCode::CurlInit:
+        return "Failed to initialize CURL";
+      case FetchErrorCode::Transport:
+        return JFetchHTTPException(http_status_, curl_easy_strerror(curl_code_)).what();
+      case FetchErrorCode::HttpStatus:
+        return JFetchHTTPException(http_status_, "Unexpected HTTP status code").what();
+      default:
+        try {
+          std::rethrow_exception(cause_);
+        } catch (const std::exception& e) {
+          return e.what();
+        } catch (...) {
+          return "Unknown decoder error";
+        }
+    }
+  }
+
+  /**
+   * @brief Throws the exception `JFetch::fetch()` would have thrown for this error.
+   */
+  [[noreturn]] void raise() const {
+    switch (code_) {
+      case FetchErrorCode::EndpointNotFound:
+        throw JFetchEndpointNotFoundException(endpoint_);
+      case FetchErrorCode::CurlInit:
+        throw JFetchException("Failed to initialize CURL");
+      case FetchErrorCode::Transport:
+        throw JFetchHTTPException(http_status_, curl_easy_strerror(curl_code_));
+      case FetchErrorCode::HttpStatus:
+        throw JFetchHTTPException(http_status_, "Unexpected HTTP status code");
+      default:
+        std::rethrow_exception(cause_);
+    }
+  }
+
+  /**
+   * @brief Returns the exception `raise()` would throw, e.g. for `std::promise::set_exception()`.
+   */
+  std::exception_ptr to_exception_ptr() const {
+    try {
+      raise();
+    } catch (...) {
+      return std::current_exception();
+    }
+  }
+
+private:
+  explicit FetchError(FetchErrorCode code) : code_(code) {}
+
+  FetchErrorCode code_;
+  long http_status_ = 0;
+  CURLcode curl_code_ = CURLE_OK;
+  std::string endpoint_;
+  std::exception_ptr cause_;
+};
+
+/**
+ * @brief Holds either a value or an error, in the spirit of C++23 `std::expected`.
+ * @tparam T Value type.
+ * @tparam E Error type; must provide `[[noreturn]] void raise() const`.
+ */
+template <typename T, typename E = FetchError>
+class Expected {
+public:
+  Expected(const T& value) : storage_(std::in_place_index<0>, value) {}
+  Expected(T&& value) : storage_(std::in_place_index<0>, std::move(value)) {}
+  Expected(E error) : storage_(std::in_place_index<1>, std::move(error)) {}
+
+  bool has_value() const { return storage_.index() == 0; }
+  explicit operator bool() const { return has_value(); }
+
+  /**
+   * @brief Returns the value, or throws the error via `E::raise()`.
+   */
+  T& value() & {
+    if (!has_value()) error().raise();
+    return std::get<0>(storage_);
+  }
+  const T& value() const& {
+    if (!has_value()) error().raise();
+    return std::get<0>(storage_);
+  }
+  T&& value() && {
+    if (!has_value()) error().raise();
+    return std::get<0>(std::move(storage_));
+  }
+
+  /**
+   * @brief Returns the value, or `fallback` on error.
+   */
+  T value_or(T fallback) const& {
+    return has_value() ? std::get<0>(storage_) : std::move(fallback);
+  }
+
+  /**
+   * @brief Returns the error; only valid when `has_value()` is `false`.
+   */
+  const E& error() const { return std::get<1>(storage_); }
+
+  T& operator*() & { return std::get<0>(storage_); }
+  const T& operator*() const& { return std::get<0>(storage_); }
+  T* operator->() { return &std::get<0>(storage_); }
+  const T* operator->() const { return &std::get<0>(storage_); }
+
+private:
+  std::variant<T, E> storage_;
+};
+
+/**
+ * @brief Per-phase timing and size breakdown of one fetch.
+ *
+ * Network phases come from libcurl (`CURLINFO_*_TIME_T`) and are converted from
+ * cumulative offsets into the duration of each phase.
+ */
+struct FetchStats {
+  std::chrono::microseconds dns{0};          ///< Name resolution
+  std::chrono::microseconds connect{0};      ///< TCP (or Unix socket) connect
+  std::chrono::microseconds tls{0};          ///< TLS handshake (0 for plain HTTP or reused connections)
+  std::chrono::microseconds first_byte{0};   ///< Request sent until the first response byte
+  std::chrono::microseconds transfer{0};     ///< First response byte until the last one
+  std::chrono::microseconds decompress{0};   ///< Content-Encoding decoding, part of `transfer` (0 if libcurl decodes)
+  std::chrono::microseconds compress{0};     ///< Request body compression
+  std::chrono::microseconds redirect{0};     ///< Time spent following redirects
+  std::chrono::microseconds parse{0};        ///< JSON parse
+  std::chrono::microseconds decode{0};       ///< Endpoint decoder
+  std::chrono::microseconds total{0};        ///< Whole call, as seen by the caller
+  std::size_t body_bytes = 0;                ///< Response body bytes received
+  std::size_t request_bytes = 0;             ///< Request body bytes sent (after compression)
+  long http_status = 0;                      ///< HTTP status code (0 if no response was received)
+  bool connection_reused = false;            ///< `true` if no new connection had to be opened
+};
+
+/**
+ * @brief Receives the `FetchStats` of every fetch; see `JFetch::set_metrics_sink()`.
+ */
+class MetricsSink {
+public:
+  virtual ~MetricsSink() = default;
+
+  /**
+   * @brief Called once per completed fetch, successful or not.
+   * @param endpoint Name of the endpoint; for `EndpointNotFound`, the unregistered name that was asked for.
+   * @param stats Timing and size breakdown.
+   * @param error The failure, or `nullptr` on success.
+   */
+  virtual void record(const std::string& endpoint, const FetchStats& stats, const FetchError* error) = 0;
+};
+
+/**
+ * @brief Adds the time until `stop()` (or destruction) to a duration; does nothing when given `nullptr`.
+ */
+class PhaseTimer {
+public:
+  explicit PhaseTimer(std::chrono::microseconds* target)
+    : target_(target), started_(target ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}) {}
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  ~PhaseTimer() { stop(); }
+
+  /**
+   * @brief Records the elapsed time; later calls are no-ops.
+   */
+  void stop() {
+    if (target_) {
+      *target_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started_);
+      target_ = nullptr;
+    }
+  }
+
+private:
+  std::chrono::microseconds* target_;
+  std::chrono::steady_clock::time_point started_;
+};
+
+/**
+ * @brief Process-wide pool of idle libcurl easy handles.
+ *
+ * Every handle the pool hands out is attached to one `CURLSH` that shares the
+ * connection and DNS caches, so back-to-back requests to the same origin, over
+ * TCP or a Unix socket, reuse a kept-alive connection instead of reconnecting,
+ * whichever handle or thread they run on. The most recently returned handle is
+ * handed out first.
+ *
+ * Call `clear()` before `curl_global_cleanup()`: the pool is a static, and
+ * libcurl must not be called once it has been cleaned up.
+ */
+class CurlHandlePool {
+public:
+  /**
+   * @brief Returns the handle to the pool when the borrower is done with it.
+   */
+  struct Release {
+    void operator()(CURL* handle) const { CurlHandlePool::instance().release(handle); }
+  };
+  using Handle = std::unique_ptr<CURL, Release>;  ///< Borrowed easy handle
+
+  static constexpr std::size_t max_idle = 64;  ///< Handles beyond this are cleaned up on release
+
+  CurlHandlePool() = default;
+  CurlHandlePool(const CurlHandlePool&) = delete;
+  CurlHandlePool& operator=(const CurlHandlePool&) = delete;
+
+  ~CurlHandlePool() { clear(); }
+
+  static CurlHandlePool& instance() {
+    static CurlHandlePool pool;
+    return pool;
+  }
+
+  /**
+   * @brief Borrows a reset handle, creating one if none is idle; empty if libcurl fails.
+   */
+  Handle acquire() {
+    CURL* handle = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!idle_.empty()) {
+        handle = idle_.back();
+        idle_.pop_back();
+      }
+    }
+    if (handle) {
+      curl_easy_reset(handle);
+    } else {
+      handle = curl_easy_init();
+    }
+    if (handle) {
+      if (CURLSH* share = shared()) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, share);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++borrowed_;
+    }
+    return Handle(handle);
+  }
+
+  /**
+   * @brief Cleans up the idle handles and, once none is borrowed, the shared caches.
+   *
+   * Call it when no fetch is running, before `curl_global_cleanup()`. The
+   * pool stays usable and starts over on the next `acquire()`.
+   */
+  void clear() {
+    std::vector<CURL*> idle;
+    CURLSH* share = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      idle.swap(idle_);
+      if (borrowed_ == 0) {
+        share = std::exchange(share_, nullptr);
+      }
+    }
+    for (CURL* handle : idle) {
+      curl_easy_cleanup(handle);
+    }
+    if (share) {
+      curl_share_cleanup(share);
+    }
+  }
+
+  /**
+   * @brief Number of idle handles, each possibly holding open connections.
+   */
+  std::size_t idle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<CURL*> idle_;
+  std::size_t borrowed_ = 0;                                 ///< Handles handed out and not released
+  CURLSH* share_ = nullptr;                                  ///< Created on first use; guarded by `mutex_`
+  std::array<std::mutex, CURL_LOCK_DATA_LAST> share_locks_;  ///< One per kind of shared data
+
+  // the shared caches, created on first use; `nullptr` if libcurl cannot allocate them
+  CURLSH* shared() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!share_ && (share_ = curl_share_init()) != nullptr) {
+      curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &CurlHandlePool::lock_share);
+      curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &CurlHandlePool::unlock_share);
+      curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+      curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+      curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    }
+    return share_;
+  }
+
+  static void lock_share(CURL*, curl_lock_data data, curl_lock_access, void* pool) {
+    static_cast<CurlHandlePool*>(pool)->share_locks_[data].lock();
+  }
+
+  static void unlock_share(CURL*, curl_lock_data data, void* pool) {
+    static_cast<CurlHandlePool*>(pool)->share_locks_[data].unlock();
+  }
+
+  void release(CURL* handle) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --borrowed_;
+      if (idle_.size() < max_idle) {
+        idle_.push_back(handle);
+        return;
+      }
+    }
+    curl_easy_cleanup(handle);
+  }
+};
+
+/**
+ * @brief Streaming decoder for the compiled-in response `Content-Encoding`s.
+ *
+ * Compressed bytes are decoded as they arrive through a small fixed staging
+ * buffer, so the response is never held compressed and decompressed at once.
+ */
+class ContentDecoder {
+public:
+  ContentDecoder() = default;
+  ContentDecoder(const ContentDecoder&) = delete;
+  ContentDecoder& operator=(const ContentDecoder&) = delete;
+  ~ContentDecoder() { reset(); }
+
+  /**
+   * @brief Encodings this build decodes, as an `Accept-Encoding` value; empty without any codec.
+   */
+  static const std::string& accepted() {
+    static const std::string list = [] {
+      std::string result;
+#if defined(JFETCH_WITH_ZSTD)
+      result += "zstd, ";
+#endif
+#if defined(JFETCH_WITH_BROTLI)
+      result += "br, ";
+#endif
+#if defined(JFETCH_WITH_ZLIB)
+      result += "gzip, deflate, ";
+#endif
+      if (!result.empty()) {
+        result.resize(result.size() - 2);
+      }
+      return result;
+    }();
+    return list;
+  }
+
+  /**
+   * @brief Prepares to decode a body with the given `Content-Encoding` value.
+   * @return `false` if the encoding is not supported by this build.
+   */
+  bool start(std::string_view encoding) {
+    reset();
+    while (!encoding.empty() && (encoding.front() == ' ' || encoding.front() == '\t')) encoding.remove_prefix(1);
+    while (!encoding.empty() && std::isspace(static_cast<unsigned char>(encoding.back()))) encoding.remove_suffix(1);
+    std::string name(encoding);
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (name.empty() || name == "identity") {
+      return true;
+    }
+#if defined(JFETCH_WITH_ZLIB)
+    if (name == "gzip" || name == "x-gzip" || name == "deflate") {
+      zlib_ = std::make_unique<z_stream>();
+      // 32 enables automatic gzip/zlib header detection
+      if (inflateInit2(zlib_.get(), 15 + 32) != Z_OK) {
+        zlib_.reset();
+        return fail();
+      }
+      kind_ = Kind::Zlib;
+      return true;
+    }
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+    if (name == "zstd") {
+      zstd_ = ZSTD_createDStream();
+      if (!zstd_) {
+        return fail();
+      }
+      kind_ = Kind::Zstd;
+      return true;
+    }
+#endif
+#if defined(JFETCH_WITH_BROTLI)
+    if (name == "br") {
+      brotli_ = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+      if (!brotli_) {
+        return fail();
+      }
+      kind_ = Kind::Brotli;
+      return true;
+    }
+#endif
+    return fail();
+  }
+
+  /**
+   * @brief Decodes `data`, handing decoded bytes to `out(const char*, std::size_t)`.
+   * @return `false` on corrupt input or an unsupported encoding.
+   */
+  template <typename Out>
+  bool feed(const char* data, std::size_t length, Out&& out) {
+    if (failed_) {
+      return false;
+    }
+    fed_ = true;
+    [[maybe_unused]] char staging[16 * 1024];
+    switch (kind_) {
+      case Kind::Identity:
+        out(data, length);
+        return true;
+#if defined(JFETCH_WITH_ZLIB)
+      case Kind::Zlib: {
+        zlib_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zlib_->avail_in = static_cast<uInt>(length);
+        while (!done_) {
+          zlib_->next_out = reinterpret_cast<Bytef*>(staging);
+          zlib_->avail_out = sizeof(staging);
+          int rc = inflate(zlib_.get(), Z_NO_FLUSH);
+          if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+            return fail();
+          }
+          out(staging, sizeof(staging) - zlib_->avail_out);
+          done_ = rc == Z_STREAM_END;
+          if (zlib_->avail_out != 0) {
+            break;
+          }
+        }
+        return true;
+      }
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+      case Kind::Zstd: {
+        ZSTD_inBuffer input{data, length, 0};
+        for (;;) {
+          ZSTD_outBuffer output{staging, sizeof(staging), 0};
+          std::size_t rc = ZSTD_decompressStream(zstd_, &output, &input);
+          if (ZSTD_isError(rc)) {
+            return fail();
+          }
+          out(staging, output.pos);
+          done_ = rc == 0;
+          if (input.pos == input.size && output.pos < output.size) {
+            break;
+          }
+        }
+        return true;
+      }
+#endif
+#if defined(JFETCH_WITH_BROTLI)
+      case Kind::Brotli: {
+        const auto* next_in = reinterpret_cast<const std::uint8_t*>(data);
+        std::size_t available_in = length;
+        while (!done_) {
+          auto* next_out = reinterpret_cast<std::uint8_t*>(staging);
+          std::size_t available_out = sizeof(staging);
+          BrotliDecoderResult rc = BrotliDecoderDecompressStream(brotli_, &available_in, &next_in,
+                                                                 &available_out, &next_out, nullptr);
+          if (rc == BROTLI_DECODER_RESULT_ERROR) {
+            return fail();
+          }
+          out(staging, sizeof(staging) - available_out);
+          done_ = rc == BROTLI_DECODER_RESULT_SUCCESS;
+          if (rc == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+            break;
+          }
+        }
+        return true;
+      }
+#endif
+      default:
+        break;
+    }
+    return fail();
+  }
+
+  /**
+   * @brief Whether a compressed encoding is being decoded.
+   */
+  bool active() const { return kind_ != Kind::Identity || failed_; }
+
+  /**
+   * @brief Whether decoding failed, or the body ended in the middle of a compressed stream.
+   */
+  bool failed() const { return failed_ || (kind_ != Kind::Identity && fed_ && !done_); }
+
+  /**
+   * @brief Releases the codec state and returns to identity.
+   */
+  void reset() {
+#if defined(JFETCH_WITH_ZLIB)
+    if (zlib_) {
+      inflateEnd(zlib_.get());
+      zlib_.reset();
+    }
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+    if (zstd_) {
+      ZSTD_freeDStream(zstd_);
+      zstd_ = nullptr;
+    }
+#endif
+#if defined(JFETCH_WITH_BROTLI)
+    if (brotli_) {
+      BrotliDecoderDestroyInstance(brotli_);
+      brotli_ = nullptr;
+    }
+#endif
+    kind_ = Kind::Identity;
+    failed_ = fed_ = done_ = false;
+  }
+
+private:
+  enum class Kind { Identity, Zlib, Zstd, Brotli };
+
+  Kind kind_ = Kind::Identity;
+  bool failed_ = false;
+  bool fed_ = false;   ///< Received at least one chunk
+  bool done_ = false;  ///< Reached the end of the compressed stream
+#if defined(JFETCH_WITH_ZLIB)
+  std::unique_ptr<z_stream> zlib_;
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+  ZSTD_DStream* zstd_ = nullptr;
+#endif
+#if defined(JFETCH_WITH_BROTLI)
+  BrotliDecoderState* brotli_ = nullptr;
+#endif
+
+  bool fail() {
+    failed_ = true;
+    return false;
+  }
+};
+
+/**
+ * @brief Content-Encoding applied to request bodies.
+ */
+enum class BodyEncoding {
+  Identity,  ///< Sent as is
+  Gzip,      ///< Requires `JFETCH_WITH_ZLIB`
+  Zstd,      ///< Requires `JFETCH_WITH_ZSTD`
+};
+
+/**
+ * @brief Per-endpoint request body compression; see `Endpoint::request_compression`.
+ */
+struct RequestCompression {
+  BodyEncoding encoding = BodyEncoding::Identity;  ///< Codec to use
+  std::size_t min_size = 1024;                     ///< Smaller bodies are sent as is
+  int level = 0;                                   ///< Codec level; 0 picks the codec's default
+};
+
+/**
+ * @brief One-shot request body compressor with per-thread codec contexts.
+ *
+ * Each thread keeps one zstd context and one deflate stream and resets them
+ * between bodies, so their tables and windows are allocated once per thread
+ * rather than on every call.
+ */
+class ContentEncoder {
+public:
+  /**
+   * @brief Whether `encoding` is compiled in.
+   */
+  static bool supported(BodyEncoding encoding) {
+    switch (encoding) {
+#if defined(JFETCH_WITH_ZLIB)
+      case BodyEncoding::Gzip: return true;
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+      case BodyEncoding::Zstd: return true;
+#endif
+      default: return false;
+    }
+  }
+
+  /**
+   * @brief Returns the `Content-Encoding` token for `encoding`.
+   */
+  static const char* name(BodyEncoding encoding) {
+    switch (encoding) {
+      case BodyEncoding::Gzip: return "gzip";
+      case BodyEncoding::Zstd: return "zstd";
+      default: return "identity";
+    }
+  }
+
+  /**
+   * @brief Compresses `input` into `output`, replacing its contents.
+   * @return `false` if the codec is not compiled in or fails.
+   */
+  static bool compress(BodyEncoding encoding, int level, std::string_view input, std::string& output) {
+    switch (encoding) {
+#if defined(JFETCH_WITH_ZLIB)
+      case BodyEncoding::Gzip: {
+        Deflater& deflater = thread_deflater();
+        int wanted = level ? level : Z_DEFAULT_COMPRESSION;
+        if (!deflater.ready) {
+          // 16 selects the gzip wrapper
+          if (deflateInit2(&deflater.stream, wanted, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+          }
+          deflater.ready = true;
+          deflater.level = wanted;
+        } else {
+          deflateReset(&deflater.stream);
+          if (deflater.level != wanted && deflateParams(&deflater.stream, wanted, Z_DEFAULT_STRATEGY) == Z_OK) {
+            deflater.level = wanted;
+          }
+        }
+
+        output.resize(deflateBound(&deflater.stream, static_cast<uLong>(input.size())));
+        deflater.stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        deflater.stream.avail_in = static_cast<uInt>(input.size());
+        deflater.stream.next_out = reinterpret_cast<Bytef*>(output.data());
+        deflater.stream.avail_out = static_cast<uInt>(output.size());
+        if (deflate(&deflater.stream, Z_FINISH) != Z_STREAM_END) {
+          return false;
+        }
+        output.resize(deflater.stream.total_out);
+        return true;
+      }
+#endif
+#if defined(JFETCH_WITH_ZSTD)
+      case BodyEncoding::Zstd: {
+        thread_local std::unique_ptr<ZSTD_CCtx, std::size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        if (!context) {
+          return false;
+        }
+        output.resize(ZSTD_compressBound(input.size()));
+        std::size_t written = ZSTD_compressCCtx(context.get(), output.data(), output.size(), input.data(), input.size(),
+                                                level ? level : ZSTD_CLEVEL_DEFAULT);
+        if (ZSTD_isError(written)) {
+          return false;
+        }
+        output.resize(written);
+        return true;
+      }
+#endif
+      default:
+        (void)level;
+        (void)input;
+        (void)output;
+        return false;
+    }
+  }
+
+private:
+#if defined(JFETCH_WITH_ZLIB)
+  struct Deflater {
+    z_stream stream{};
+    int level = Z_DEFAULT_COMPRESSION;
+    bool ready = false;
+
+    ~Deflater() {
+      if (ready) {
+        deflateEnd(&stream);
+      }
+    }
+  };
+
+  static Deflater& thread_deflater() {
+    thread_local Deflater deflater;
+    return deflater;
+  }
+#endif
+};
+
+/**
+ * @brief Cuts a top-level JSON array into its elements while the body is still arriving.
+ *
+ * Takes the place of the body buffer in `JFetch::fetch_each()`: each element's
+ * text goes to the handler as soon as its closing byte is in, and is dropped
+ * afterwards. An element inside one received chunk is passed without copying;
+ * only one that straddles chunks is gathered, so about one element is held at
+ * a time. Only the array itself is checked here; elements are validated by
+ * whoever parses them.
+ */
+class JsonArraySplitter {
+public:
+  /// Receives one element's JSON text; returns `false` to stop splitting.
+  using Handler = std::function<bool(std::string_view element)>;
+
+  explicit JsonArraySplitter(Handler handler) : handler_(std::move(handler)) {}
+
+  /**
+   * @brief Scans the next bytes of the body, emitting every element they complete.
+   */
+  void append(const char* data, std::size_t length) {
+    std::size_t offset = received_;
+    received_ += length;
+    const char* end = data + length;
+    const char* start = data;  // the current element's first byte within this chunk
+    for (const char* p = data; p < end && !halted(); ++p) {
+      char c = *p;
+      switch (state_) {
+        case State::Start:
+          if (c == '[') {
+            state_ = State::Open;
+          } else if (!is_space(c)) {
+            fail("expected a top-level JSON array", offset + (p - data));
+          }
+          break;
+        case State::Open:
+          if (is_space(c)) {
+            break;
+          }
+          if (c == ']' && elements_ == 0) {
+            state_ = State::Done;
+            break;
+          }
+          if (c == ',' || c == ']') {
+            fail("expected an array element", offset + (p - data));
+            break;
+          }
+          state_ = State::Element;
+          start = p;
+          [[fallthrough]];
+        case State::Element:
+          if (in_string_) {
+            if (escaped_) {
+              escaped_ = false;
+            } else if (c == '\\') {
+              escaped_ = true;
+            } else if (c == '"') {
+              in_string_ = false;
+            }
+          } else if (c == '"') {
+            in_string_ = true;
+          } else if (c == '{' || c == '[') {
+            ++depth_;
+          } else if ((c == '}' || c == ']') && depth_ > 0) {
+            --depth_;
+          } else if (depth_ == 0 && (c == ',' || c == ']')) {
+            state_ = c == ',' ? State::Open : State::Done;
+            emit(start, p);
+          }
+          break;
+        case State::Done:
+          if (!is_space(c)) {
+            fail("unexpected data after the top-level array", offset + (p - data));
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    if (state_ == State::Element) {
+      partial_.append(start, static_cast<std::size_t>(end - start));
+    }
+  }
+
+  /**
+   * @brief No-op: elements are consumed as they arrive, so nothing is pre-sized.
+   */
+  void reserve(std::size_t) {}
+
+  /**
+   * @brief Body bytes scanned so far.
+   */
+  std::size_t size() const { return received_; }
+
+  /**
+   * @brief Elements handed to the handler so far.
+   */
+  std::size_t elements() const { return elements_; }
+
+  /**
+   * @brief Whether the handler asked to stop.
+   */
+  bool stopped() const { return state_ == State::Stopped; }
+
+  /**
+   * @brief Whether further bytes are ignored, because the handler stopped or the array is malformed.
+   */
+  bool halted() const { return state_ == State::Stopped || state_ == State::Malformed; }
+
+  /**
+   * @brief Checks that the body was one complete array, unless the handler stopped early.
+   * @throws JFetchParsingException If the array is malformed or truncated.
+   */
+  void finish() const {
+    if (state_ == State::Malformed) {
+      throw JFetchParsingException(error_);
+    }
+    if (state_ != State::Done && state_ != State::Stopped) {
+      throw JFetchParsingException("unexpected end of input after " + std::to_string(received_) +
+                                   " bytes; expected the end of the top-level array");
+    }
+  }
+
+private:
+  enum class State { Start, Open, Element, Done, Stopped, Malformed };
+
+  Handler handler_;
+  State state_ = State::Start;
+  std::size_t depth_ = 0;         ///< Nesting inside the current element
+  bool in_string_ = false;
+  bool escaped_ = false;
+  std::string partial_;           ///< Earlier chunks of an element that straddles chunks
+  std::size_t received_ = 0;
+  std::size_t elements_ = 0;
+  std::string error_;
+
+  static bool is_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+  void emit(const char* start, const char* end) {
+    std::string_view element(start, static_cast<std::size_t>(end - start));
+    if (!partial_.empty()) {
+      partial_.append(element);
+      element = partial_;
+    }
+    ++elements_;
+    bool more = handler_(element);
+    // keeps its capacity: later straddling elements reuse it
+    partial_.clear();
+    if (!more) {
+      state_ = State::Stopped;
+    }
+  }
+
+  void fail(const char* message, std::size_t offset) {
+    state_ = State::Malformed;
+    error_ = std::string(message) + " at byte " + std::to_string(offset);
+  }
+};
+
+/**
+ * @brief Destination of one transfer: the body buffer, its decoder and optional stats.
+ *
+ * Must outlive the transfer; libcurl's callbacks point at it.
+ */
+template <typename Buffer>
+struct ResponseSink {
+  explicit ResponseSink(Buffer& body, FetchStats* stats = nullptr) : body(body), stats(stats) {}
+
+  Buffer& body;                          ///< Receives the decoded response body
+  FetchStats* stats;                     ///< Receives `decompress` time (may be `nullptr`)
+  ContentDecoder decoder;                ///< Decodes `Content-Encoding` when `decode` is set
+  bool decode = false;                   ///< Whether JFetch, rather than libcurl, decodes the body
+  WireFormat format = WireFormat::Json;  ///< From the response's `Content-Type`
+  long status = 0;                       ///< From the status line of the response being received
+};
+
+/**
+ * @brief Streamed request body, pulled in chunks while libcurl uploads it.
+ *
+ * Only one upload buffer's worth of the body is in memory at a time, so
+ * uploads of many GB run in constant memory. A source whose size is known up
+ * front is sent with a `Content-Length`; otherwise the body goes out with
+ * `Transfer-Encoding: chunked`. Pass one to `fetch()` wrapped in a
+ * `RequestBody`. A source is consumed by the request that sends it.
+ */
+class BodySource {
+public:
+  /// Returned by `read()` when the source fails; the transfer is aborted.
+  static constexpr std::size_t read_error = static_cast<std::size_t>(-1);
+
+  virtual ~BodySource() = default;
+
+  /**
+   * @brief Copies the next bytes of the body into `buffer`.
+   * @return Bytes written (at most `capacity`), 0 at the end of the body, or `read_error`.
+   */
+  std::size_t read(char* buffer, std::size_t capacity) {
+    std::size_t produced = produce(buffer, capacity);
+    if (produced != read_error) {
+      consumed_ += produced;
+    }
+    return produced;
+  }
+
+  /**
+   * @brief Starts over from the first byte, e.g. to re-send the body after a redirect.
+   * @return `false` if the source cannot be replayed.
+   */
+  bool rewind() {
+    if (!restart()) {
+      return false;
+    }
+    consumed_ = 0;
+    return true;
+  }
+
+  /**
+   * @brief Total body size, if known before the upload starts.
+   */
+  virtual std::optional<std::size_t> size() const { return std::nullopt; }
+
+  /**
+   * @brief Bytes handed out by `read()` so far.
+   */
+  std::size_t consumed() const { return consumed_; }
+
+protected:
+  virtual std::size_t produce(char* buffer, std::size_t capacity) = 0;
+  virtual bool restart() { return false; }
+
+private:
+  std::size_t consumed_ = 0;
+};
+
+/**
+ * @brief Body produced on the fly by a callback, e.g. an NDJSON export serialized row by row.
+ *
+ * The callback writes up to `capacity` bytes and returns how many it wrote,
+ * 0 once the body is complete, or `BodySource::read_error`. A callback that
+ * throws aborts the upload. Generated bodies cannot be replayed.
+ */
+class GeneratorBodySource : public BodySource {
+public:
+  using Generator = std::function<std::size_t(char* buffer, std::size_t capacity)>;
+
+  explicit GeneratorBodySource(Generator generator) : generator_(std::move(generator)) {}
+
+protected:
+  std::size_t produce(char* buffer, std::size_t capacity) override { return generator_(buffer, capacity); }
+
+private:
+  Generator generator_;
+};
+
+#if defined(JFETCH_HAS_POSIX_IO)
+/**
+ * @brief Body read from a file descriptor: a regular file, pipe or socket.
+ *
+ * Regular files are sent with their `fstat()` size from the current offset
+ * and can be replayed; pipes and sockets are sent chunked.
+ */
+class FileBodySource : public BodySource {
+public:
+  /**
+   * @brief Opens `path` for reading; the descriptor is closed with the source.
+   * @throws JFetchException If the file cannot be opened.
+   */
+  explicit FileBodySource(const std::string& path) : FileBodySource(::open(path.c_str(), O_RDONLY | O_CLOEXEC), true) {
+    if (fd_ < 0) {
+      throw JFetchException("Failed to open request body file: " + path + ": " + std::strerror(errno));
+    }
+  }
+
+  /**
+   * @brief Reads from an open descriptor, starting at its current offset.
+   * @param owned Whether the source closes `fd` when destroyed.
+   */
+  explicit FileBodySource(int fd, bool owned = false) : fd_(fd), owned_(owned) {
+    struct stat info {};
+    if (fd_ >= 0 && ::fstat(fd_, &info) == 0 && S_ISREG(info.st_mode)) {
+      start_ = ::lseek(fd_, 0, SEEK_CUR);
+      if (start_ >= 0 && start_ <= info.st_size) {
+        size_ = static_cast<std::size_t>(info.st_size - start_);
+      }
+    }
+  }
+
+  FileBodySource(const FileBodySource&) = delete;
+  FileBodySource& operator=(const FileBodySource&) = delete;
+
+  ~FileBodySource() override {
+    if (owned_ && fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  std::optional<std::size_t> size() const override { return size_; }
+
+protected:
+  std::size_t produce(char* buffer, std::size_t capacity) override {
+    for (;;) {
+      ssize_t got = ::read(fd_, buffer, capacity);
+      if (got >= 0) {
+        return static_cast<std::size_t>(got);
+      }
+      if (errno != EINTR) {
+        return read_error;
+      }
+    }
+  }
+
+  bool restart() override { return size_ && ::lseek(fd_, start_, SEEK_SET) == start_; }
+
+private:
+  int fd_;
+  bool owned_;
+  off_t start_ = -1;
+  std::optional<std::size_t> size_;
+};
+
+/**
+ * @brief Body served from a read-only memory mapping of a file.
+ *
+ * Saves the `read()` system call per upload chunk. Pages already sent are
+ * dropped from the mapping as the upload progresses, so resident memory
+ * stays flat even for files larger than RAM.
+ */
+class MappedBodySource : public BodySource {
+public:
+  /**
+   * @brief Maps `path` read-only.
+   * @throws JFetchException If the file cannot be opened or mapped.
+   */
+  explicit MappedBodySource(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info {};
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+      int error = errno;
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw JFetchException("Failed to open request body file: " + path + ": " + std::strerror(error));
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    if (size_ > 0) {
+      void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      int error = errno;
+      ::close(fd);
+      if (mapped == MAP_FAILED) {
+        throw JFetchException("Failed to map request body file: " + path + ": " + std::strerror(error));
+      }
+      data_ = static_cast<const char*>(mapped);
+      ::madvise(mapped, size_, MADV_SEQUENTIAL);
+    } else {
+      ::close(fd);
+    }
+  }
+
+  MappedBodySource(const MappedBodySource&) = delete;
+  MappedBodySource& operator=(const MappedBodySource&) = delete;
+
+  ~MappedBodySource() override {
+    if (data_) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  std::optional<std::size_t> size() const override { return size_; }
+
+protected:
+  std::size_t produce(char* buffer, std::size_t capacity) override {
+    std::size_t count = std::min(capacity, size_ - offset_);
+    std::memcpy(buffer, data_ + offset_, count);
+    offset_ += count;
+
+    // release whole windows behind the read position; the page cache keeps them if they are hot
+    if (offset_ - released_ >= release_window) {
+      std::size_t end = offset_ - offset_ % release_window;
+      ::madvise(const_cast<char*>(data_) + released_, end - released_, MADV_DONTNEED);
+      released_ = end;
+    }
+    return count;
+  }
+
+  bool restart() override {
+    offset_ = 0;
+    released_ = 0;
+    return true;
+  }
+
+private:
+  static constexpr std::size_t release_window = std::size_t{8} << 20;
+
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t offset_ = 0;
+  std::size_t released_ = 0;
+};
+#endif
+
+/**
+ * @brief Request payload that either borrows or owns its bytes.
+ *
+ * Lvalue strings, `std::string_view`s and C strings are borrowed without a
+ * copy and must stay valid until the call that takes the body returns; for
+ * `fetch()` and `try_fetch()` that is simply the call itself. Rvalue strings
+ * are moved in and owned. `fetch_async()` copies a borrowed body, because the
+ * transfer outlives the call. The size is always passed to libcurl
+ * explicitly, so binary bodies containing NUL bytes are sent intact. A
+ * `BodySource` streams the body instead of holding it in memory. A
+ * `nlohmann::json` value is serialized straight into a pooled buffer.
+ */
+class RequestBody {
+public:
+  RequestBody() = default;
+  RequestBody(const std::string& text) : view_(text) {}
+  RequestBody(std::string&& text) : owned_(std::move(text)), owns_(true) {}
+  RequestBody(std::string_view text) : view_(text) {}
+  RequestBody(const char* text) : view_(text) {}
+  template <typename Source, typename = std::enable_if_t<std::is_base_of_v<BodySource, Source>>>
+  RequestBody(std::shared_ptr<Source> source) : source_(std::move(source)) {}
+
+  /**
+   * @brief Serializes `value` (as `dump()` would) into a buffer borrowed from `BufferPool`.
+   *
+   * No intermediate string is built, and the buffer goes back to the pool when
+   * the body is destroyed, so steady-state JSON uploads do not allocate. Each
+   * thread sizes the buffer from its previous serialized body.
+   */
+  RequestBody(const nlohmann::json& value)
+    : owned_(BufferPool::instance().acquire(last_serialized_size())), owns_(true), pooled_(true) {
+    // nlohmann's public stream output, pointed at the pooled string
+    StringAppender appender(owned_);
+    std::ostream stream(&appender);
+    stream << value;
+    last_serialized_size() = owned_.size();
+  }
+
+  RequestBody(const RequestBody&) = default;
+  RequestBody(RequestBody&& other) noexcept
+    : view_(other.view_), owned_(std::move(other.owned_)), source_(std::move(other.source_)),
+      owns_(other.owns_), pooled_(std::exchange(other.pooled_, false)) {}
+
+  RequestBody& operator=(const RequestBody& other) {
+    if (this != &other) {
+      *this = RequestBody(other);
+    }
+    return *this;
+  }
+
+  RequestBody& operator=(RequestBody&& other) noexcept {
+    if (this != &other) {
+      recycle();
+      view_ = other.view_;
+      owned_ = std::move(other.owned_);
+      source_ = std::move(other.source_);
+      owns_ = other.owns_;
+      pooled_ = std::exchange(other.pooled_, false);
+    }
+    return *this;
+  }
+
+  ~RequestBody() { recycle(); }
+
+  std::string_view view() const { return owns_ ? std::string_view(owned_) : view_; }
+  const char* data() const { return view().data(); }
+  std::size_t size() const { return view().size(); }
+  bool empty() const { return !source_ && size() == 0; }
+
+  /**
+   * @brief The streamed source, or `nullptr` for an in-memory body.
+   */
+  BodySource* source() const { return source_.get(); }
+
+  /**
+   * @brief Whether the body holds its own bytes rather than borrowing them.
+   */
+  bool owns() const { return owns_; }
+
+  /**
+   * @brief Copies borrowed bytes so the body no longer refers to the caller's buffer.
+   */
+  void own() {
+    if (!owns_) {
+      owned_.assign(view_.data(), view_.size());
+      view_ = {};
+      owns_ = true;
+    }
+  }
+
+  /**
+   * @brief Swaps in new bytes (e.g. the compressed body), returning a pooled buffer to `BufferPool` first.
+   * @param pooled Whether `bytes` was taken from `BufferPool` and goes back to it.
+   */
+  void replace(std::string&& bytes, bool pooled = false) {
+    recycle();
+    view_ = {};
+    owned_ = std::move(bytes);
+    source_.reset();
+    owns_ = true;
+    pooled_ = pooled;
+  }
+
+private:
+  /// Appends everything written through it to a string.
+  class StringAppender : public std::streambuf {
+  public:
+    explicit StringAppender(std::string& out) : out_(out) {}
+
+  protected:
+    int_type overflow(int_type c) override {
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        out_.push_back(traits_type::to_char_type(c));
+      }
+      return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize count) override {
+      out_.append(data, static_cast<std::size_t>(count));
+      return count;
+    }
+
+  private:
+    std::string& out_;
+  };
+
+  std::string_view view_;
+  std::string owned_;
+  std::shared_ptr<BodySource> source_;
+  bool owns_ = false;
+  bool pooled_ = false;
+
+  static std::size_t& last_serialized_size() {
+    thread_local std::size_t size = 0;
+    return size;
+  }
+
+  void recycle() {
+    if (pooled_) {
+      BufferPool::instance().release(std::move(owned_));
+      pooled_ = false;
+    }
+  }
+};
+
+/**
+ * @brief Serializes any type with a `to_json()` overload into a pooled request body.
+ *
+ * `nlohmann::json` values are serialized directly; other types are converted
+ * to a `nlohmann::json` first.
+ */
+template <typename Value>
+RequestBody json_body(const Value& value) {
+  if constexpr (std::is_same_v<Value, nlohmann::json>) {
+    return RequestBody(value);
+  } else {
+    return RequestBody(nlohmann::json(value));
+  }
+}
+
+/**
+ * @brief Internal class to handle HTTP transactions via libcurl.
+ */
+class HttpClient {
+public:
+  /**
+   * @brief Constructs a new HttpClient.
+   * @param url Target URL for the HTTP request.
+   * @param method HTTP method to use.
+   * @param headers Optional HTTP headers.
+   * @param body Optional request body; a borrowed body must outlive the client.
+   */
+  HttpClient(const std::string& url,
+         RequestMethod method,
+         const std::vector<std::string>& headers = {},
+         RequestBody body = {})
+    : url_(url), method_(method), body_(std::move(body)) {
+    // skip libcurl's Expect: 100-continue round trip (a full second against servers that ignore it) for large bodies
+    if (sends_body()) {
+      add_header("Expect:");
+      if (body_.source() && !body_.source()->size()) {
+        add_header("Transfer-Encoding: chunked");
+      }
+    }
+    add_headers(headers);
+  }
+
+  /**
+   * @brief Appends one header line (e.g. `"traceparent: ..."`) to the request.
+   */
+  void add_header(const std::string& header) {
+    curl_slist* appended = curl_slist_append(header_list_.get(), header.c_str());
+    if (appended) {
+      header_list_.release();
+      header_list_.reset(appended);
+    }
+  }
+
+  /**
+   * @brief Appends several header lines to the request.
+   */
+  void add_headers(const std::vector<std::string>& headers) {
+    for (const auto& header : headers) {
+      add_header(header);
+    }
+  }
+
+  /**
+   * @brief Compresses the body as configured and adds the matching `Content-Encoding` header.
+   *
+   * The body is sent as is when it is below `min_size`, the method carries no
+   * body, the codec is not compiled in, or compression would not shrink it.
+   * Streamed bodies are never compressed.
+   *
+   * @param compression Codec, threshold and level.
+   * @param stats Optional; receives the compression time.
+   */
+  void compress_body(const RequestCompression& compression, FetchStats* stats = nullptr) {
+    if (compression.encoding == BodyEncoding::Identity || !sends_body() || body_.source() ||
+        body_.size() < compression.min_size ||
+        !ContentEncoder::supported(compression.encoding)) {
+      return;
+    }
+
+    PhaseTimer timer(stats ? &stats->compress : nullptr);
+    // covers the worst-case output of both codecs, so the pooled buffer is never regrown
+    std::string compressed = BufferPool::instance().acquire(body_.size() + body_.size() / 128 + 1024);
+    if (ContentEncoder::compress(compression.encoding, compression.level, body_.view(), compressed) &&
+        compressed.size() < body_.size()) {
+      body_.replace(std::move(compressed), true);
+      add_header(std::string("Content-Encoding: ") + ContentEncoder::name(compression.encoding));
+    } else {
+      BufferPool::instance().release(std::move(compressed));
+    }
+  }
+
+  /**
+   * @brief Negotiates a compressed response via `Accept-Encoding`; see `JFETCH_WITH_ZLIB`.
+   */
+  void set_accept_compressed(bool accept) {
+    accept_compressed_ = accept;
+  }
+
+  /**
+   * @brief Connects through a Unix domain socket instead of the URL's host and port.
+   * @param path Socket path; empty for a regular TCP connection.
+   */
+  void set_unix_socket(std::string path) {
+    unix_socket_ = std::move(path);
+  }
+
+  /**
+   * @brief Performs the HTTP request and stores the response.
+   * @tparam Buffer `std::string` or `ChunkedBuffer`.
+   * @param response Buffer to receive the response body.
+   * @return `true` on success, throws on failure.
+   */
+  template <typename Buffer>
+  bool perform_request(Buffer& response) const {
+    TransferResult result = perform(response);
+    if (!result.ok()) {
+      FetchError::from_transfer(result).raise();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Performs the HTTP request without throwing on transfer or status errors.
+   * @tparam Buffer `std::string` or `ChunkedBuffer`.
+   * @param response Buffer to receive the response body.
+   * @param stats Optional; receives network phase timings, body size and connection reuse.
+   * @return libcurl result and HTTP status.
+   */
+  template <typename Buffer>
+  TransferResult perform(Buffer& response, FetchStats* stats = nullptr) const {
+    CurlHandlePool::Handle curl = CurlHandlePool::instance().acquire();
+    if (!curl) {
+      TransferResult result;
+      result.curl_code = CURLE_FAILED_INIT;
+      return result;
+    }
+
+    ResponseSink<Buffer> sink(response, stats);
+    prepare(curl.get(), sink);
+    JFETCH_PROBE1(request__start, url_.c_str());
+    TransferResult result = finish(curl.get(), curl_easy_perform(curl.get()), sink);
+    if (result.curl_code == CURLE_SEND_FAIL_REWIND) {
+      // libcurl still wants that rewind after curl_easy_reset(), so every later
+      // upload on the handle would fail the same way; don't return it to the pool
+      curl_easy_cleanup(curl.release());
+    }
+    return result;
+  }
+
+  /**
+   * @brief Configures an easy handle for this request without running it (e.g. for a multi handle).
+   *
+   * The client and `sink` must outlive the transfer: the handle refers to
+   * the header list and body owned by the client.
+   */
+  template <typename Buffer>
+  void prepare(CURL* curl, ResponseSink<Buffer>& sink) const {
+    curl_easy_setopt(curl, CURLOPT_URL, url_.c_str());
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method_to_string().c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback<Buffer>);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback<Buffer>);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &sink);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list_.get());
+
+    if (!unix_socket_.empty()) {
+      curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, unix_socket_.c_str());
+    }
+
+    // with codecs compiled in, advertise exactly those and decode in write_callback
+    sink.decode = accept_compressed_ && !ContentDecoder::accepted().empty();
+    if (sink.decode) {
+      curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ContentDecoder::accepted().c_str());
+      curl_easy_setopt(curl, CURLOPT_HTTP_CONTENT_DECODING, 0L);
+    } else if (accept_compressed_) {
+      curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    }
+
+    if (BodySource* source = body_.source(); source && sends_body()) {
+      // streamed: libcurl pulls the body through read_callback, chunked if the size is unknown
+      std::optional<std::size_t> size = source->size();
+      curl_easy_setopt(curl, CURLOPT_POST, 1L);
+      curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_callback);
+      curl_easy_setopt(curl, CURLOPT_READDATA, source);
+      curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, seek_callback);
+      curl_easy_setopt(curl, CURLOPT_SEEKDATA, source);
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, size ? static_cast<curl_off_t>(*size) : curl_off_t{-1});
+    } else if (sends_body()) {
+      // explicit size: compressed bodies contain NUL bytes
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body_.data());
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body_.size()));
+    }
+  }
+
+  /**
+   * @brief Collects the outcome of a finished transfer on a prepared handle.
+   * @param curl Handle previously set up with `prepare()`.
+   * @param code Result of `curl_easy_perform()` or `CURLMSG_DONE`.
+   * @param sink The sink passed to `prepare()`; its stats receive network phase
+   *             timings, body size and connection reuse.
+   */
+  template <typename Buffer>
+  TransferResult finish(CURL* curl, CURLcode code, const ResponseSink<Buffer>& sink) const {
+    TransferResult result;
+    result.curl_code = (code == CURLE_OK || code == CURLE_WRITE_ERROR) && sink.decoder.failed()
+      ? CURLE_BAD_CONTENT_ENCODING : code;
+    FetchStats* stats = sink.stats;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &result.http_status);
+    result.format = sink.format;
+    JFETCH_PROBE3(request__done, url_.c_str(), static_cast<int>(result.curl_code), result.http_status);
+
+    if (stats) {
+      collect_stats(curl, code, *stats);
+      stats->http_status = result.http_status;
+    }
+
+    return result;
+  }
+
+  const std::string& url() const { return url_; }
+  RequestMethod method() const { return method_; }
+  std::string_view body() const { return body_.view(); }
+  BodySource* body_source() const { return body_.source(); }
+  const curl_slist* headers() const { return header_list_.get(); }
+  const std::string& unix_socket() const { return unix_socket_; }
+  bool accepts_compressed() const { return accept_compressed_; }
+
+  /**
+   * @brief Request body bytes sent so far; for in-memory bodies, the whole body.
+   */
+  std::size_t body_bytes() const { return body_.source() ? body_.source()->consumed() : body_.size(); }
+
+  /**
+   * @brief Whether the body is sent; only POST, PUT and PATCH carry one.
+   */
+  bool sends_body() const {
+    return !body_.empty() &&
+      (method_ == RequestMethod::POST ||
+       method_ == RequestMethod::PUT ||
+       method_ == RequestMethod::PATCH);
+  }
+
+  /**
+   * @brief Converts the enum method to a string.
+   */
+  std::string method_to_string() const {
+    switch (method_) {
+      case RequestMethod::GET: return "GET";
+      case RequestMethod::POST: return "POST";
+      case RequestMethod::PUT: return "PUT";
+      case RequestMethod::DEL: return "DELETE";
+      case RequestMethod::PATCH: return "PATCH";
+      default: return "GET";
+    }
+  }
+
+  /**
+   * @brief Upper bound for pre-sizing from Content-Length, so a bogus header can't exhaust memory.
+   */
+  static constexpr std::size_t max_presize = std::size_t{256} << 20;
+
+private:
+  std::string url_;
+  RequestMethod method_;
+  std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> header_list_{nullptr, curl_slist_free_all};
+  RequestBody body_;
+  std::string unix_socket_;
+  bool accept_compressed_ = false;
+
+  /**
+   * @brief Converts libcurl's cumulative timings into per-phase durations.
+   */
+  static void collect_stats(CURL* curl, CURLcode code, FetchStats& stats) {
+    curl_off_t namelookup = 0, connect = 0, appconnect = 0, pretransfer = 0;
+    curl_off_t starttransfer = 0, total = 0, redirect = 0, downloaded = 0, uploaded = 0;
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_REDIRECT_TIME_T, &redirect);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+
+    // phases that did not happen (reused connection, plain HTTP) report 0
+    auto phase = [](curl_off_t end, curl_off_t begin) {
+      return std::chrono::microseconds(end > begin ? end - begin : 0);
+    };
+
+    stats.dns = phase(namelookup, 0);
+    stats.connect = phase(connect, namelookup);
+    stats.tls = appconnect > 0 ? phase(appconnect, connect) : std::chrono::microseconds(0);
+    stats.first_byte = phase(starttransfer, pretransfer);
+    stats.transfer = phase(total, starttransfer);
+    stats.redirect = phase(redirect, 0);
+    stats.body_bytes = static_cast<std::size_t>(downloaded);
+    stats.request_bytes = static_cast<std::size_t>(uploaded);
+    // a failed resolve or connect also opens no connection; only a transfer that got past connect can have reused one
+    stats.connection_reused = connects == 0 && (code == CURLE_OK || pretransfer > 0);
+  }
+
+  /**
+   * @brief Callback for libcurl to pull the next chunk of a streamed request body.
+   */
+  static size_t read_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    try {
+      std::size_t produced = static_cast<BodySource*>(userdata)->read(buffer, size * nitems);
+      return produced == BodySource::read_error ? CURL_READFUNC_ABORT : produced;
+    } catch (...) {
+      // exceptions must not unwind through libcurl
+      return CURL_READFUNC_ABORT;
+    }
+  }
+
+  /**
+   * @brief Callback for libcurl to rewind a streamed request body, e.g. on a redirect.
+   */
+  static int seek_callback(void* userdata, curl_off_t offset, int origin) {
+    if (offset != 0 || origin != SEEK_SET) {
+      return CURL_SEEKFUNC_CANTSEEK;
+    }
+    return static_cast<BodySource*>(userdata)->rewind() ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_CANTSEEK;
+  }
+
+  /**
+   * @brief Callback for libcurl to write response data.
+   */
+  template <typename Buffer>
+  static size_t write_callback(void* contents, size_t size, size_t nmemb, ResponseSink<Buffer>* sink) {
+    std::size_t length = size * nmemb;
+    JFETCH_PROBE1(write__chunk, length);
+    if constexpr (std::is_same_v<Buffer, JsonArraySplitter>) {
+      // an error response's body is not the array; only its status is reported
+      if (sink->status < 200 || sink->status >= 300) {
+        return length;
+      }
+    }
+    if (!sink->decoder.active()) {
+      sink->body.append(static_cast<char*>(contents), length);
+      return accepting(sink->body) ? length : 0;
+    }
+
+    PhaseTimer timer(sink->stats ? &sink->stats->decompress : nullptr);
+    bool decoded = sink->decoder.feed(static_cast<const char*>(contents), length,
+                                      [sink](const char* data, std::size_t bytes) { sink->body.append(data, bytes); });
+    return decoded && accepting(sink->body) ? length : 0;
+  }
+
+  /**
+   * @brief Whether the buffer wants more of the body; a halted splitter aborts the transfer.
+   */
+  template <typename Buffer>
+  static bool accepting(const Buffer&) { return true; }
+  static bool accepting(const JsonArraySplitter& splitter) { return !splitter.halted(); }
+
+  /**
+   * @brief Callback for libcurl response headers.
+   *
+   * Reserves the body buffer from Content-Length and, when JFetch decodes the
+   * body itself, sets up the decoder from Content-Encoding.
+   */
+  template <typename Buffer>
+  static size_t header_callback(char* buffer, size_t size, size_t nitems, ResponseSink<Buffer>* sink) {
+    std::size_t length = size * nitems;
+    std::string_view line(buffer, length);
+
+    // each response (interim 1xx, redirects) starts with its status line
+    if (line.compare(0, 5, "HTTP/") == 0) {
+      sink->decoder.reset();
+      sink->format = WireFormat::Json;
+      sink->status = 0;
+      if (std::size_t space = line.find(' '); space != std::string_view::npos) {
+        std::from_chars(line.data() + space + 1, line.data() + line.size(), sink->status);
+      }
+    } else if (auto content_type = header_value(line, "content-type:")) {
+      sink->format = wire_format_of(*content_type);
+    } else if (auto value = header_value(line, "content-length:")) {
+      unsigned long long content_length = 0;
+      std::from_chars(value->data(), value->data() + value->size(), content_length);
+      if (content_length > 0 && content_length <= max_presize) {
+        sink->body.reserve(sink->body.size() + static_cast<std::size_t>(content_length));
+      }
+    } else if (sink->decode) {
+      if (auto encoding = header_value(line, "content-encoding:")) {
+        sink->decoder.start(*encoding);
+      }
+    }
+    return length;
+  }
+
+  /**
+   * @brief Returns the value of a header line if its name matches `name` (lowercase, with colon).
+   */
+  static std::optional<std::string_view> header_value(std::string_view line, std::string_view name) {
+    if (line.size() <= name.size()) {
+      return std::nullopt;
+    }
+    for (std::size_t i = 0; i < name.size(); ++i) {
+      if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) {
+        return std::nullopt;
+      }
+    }
+    line.remove_prefix(name.size());
+    while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) line.remove_prefix(1);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n' || line.back() == ' ')) line.remove_suffix(1);
+    return line;
+  }
+};
+
+/**
+ * @brief Carries out the HTTP exchange described by an `HttpClient`; see `JFetch::set_transport()`.
+ *
+ * Implementations report failures through `TransferResult` using the closest
+ * `CURLcode`, so `FetchError` and the exceptions of `fetch()` stay the same
+ * whichever transport is in use. `perform()` may be called from several
+ * threads at once.
+ */
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  /**
+   * @brief Sends `request` and appends the response body to `response`.
+   * @param request URL, method, headers and body of the request.
+   * @param response Buffer to receive the response body.
+   * @param stats Optional; receives phase timings, body size and connection reuse.
+   */
+  virtual TransferResult perform(const HttpClient& request, ChunkedBuffer& response, FetchStats* stats) = 0;
+
+  /**
+   * @brief Pooled connections waiting for a request, reported as `jfetch_connection_pool_idle`.
+   */
+  virtual std::size_t idle() const { return 0; }
+};
+
+/**
+ * @brief Default transport: one libcurl easy transfer per request.
+ */
+class CurlTransport : public Transport {
+public:
+  TransferResult perform(const HttpClient& request, ChunkedBuffer& response, FetchStats* stats) override {
+    return request.perform(response, stats);
+  }
+};
+
+/**
+ * @brief Installs a memory resource as the current thread's JSON arena for its lifetime.
+ *
+ * While a scope is active, `ArenaAllocator` draws from its resource. Memory is
+ * handed back to wherever it came from, whichever scope is active when it is
+ * freed; with a monotonic resource that is a no-op, and the whole arena is
+ * released in one shot afterwards.
+ */
+class ArenaScope {
+public:
+  /**
+   * @brief Makes `resource` the current arena, remembering the previous one.
+   * @param resource Arena to allocate from (typically a `std::pmr::monotonic_buffer_resource`).
+   */
+  explicit ArenaScope(std::pmr::memory_resource* resource) : previous_(current_ref()) {
+    current_ref() = resource;
+  }
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+  ~ArenaScope() { current_ref() = previous_; }
+
+  /**
+   * @brief Returns the current thread's arena, or `nullptr` outside any scope.
+   */
+  static std::pmr::memory_resource* current() { return current_ref(); }
+
+private:
+  std::pmr::memory_resource* previous_;
+
+  static std::pmr::memory_resource*& current_ref() {
+    thread_local std::pmr::memory_resource* resource = nullptr;
+    return resource;
+  }
+};
+
+/**
+ * @brief Stateless allocator that routes to the current `ArenaScope`, or the global heap outside one.
+ *
+ * `nlohmann::basic_json` default-constructs its allocators, so the arena is
+ * found through a thread-local rather than carried in the allocator. Each
+ * block starts with a one-pointer header naming the resource it came from
+ * (`nullptr` for the heap), so `deallocate()` frees it there even when the
+ * scope has changed in between.
+ */
+template <typename U>
+struct ArenaAllocator {
+  using value_type = U;
+
+  ArenaAllocator() noexcept = default;
+  template <typename V>
+  ArenaAllocator(const ArenaAllocator<V>&) noexcept {}
+
+  U* allocate(std::size_t n) {
+    static_assert(alignof(U) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned types are not supported");
+    std::pmr::memory_resource* source = ArenaScope::current();
+    std::size_t bytes = header_size() + n * sizeof(U);
+    char* block = static_cast<char*>(source ? source->allocate(bytes, alignment()) : ::operator new(bytes));
+    std::memcpy(block + header_size() - sizeof(source), &source, sizeof(source));
+    return reinterpret_cast<U*>(block + header_size());
+  }
+
+  void deallocate(U* p, std::size_t n) noexcept {
+    char* block = reinterpret_cast<char*>(p) - header_size();
+    std::pmr::memory_resource* source;
+    std::memcpy(&source, block + header_size() - sizeof(source), sizeof(source));
+    if (source) {
+      source->deallocate(block, header_size() + n * sizeof(U), alignment());
+    } else {
+      ::operator delete(block);
+    }
+  }
+
+  template <typename V>
+  bool operator==(const ArenaAllocator<V>&) const noexcept { return true; }
+  template <typename V>
+  bool operator!=(const ArenaAllocator<V>&) const noexcept { return false; }
+
+private:
+  // the header keeps `U` aligned and is at least one pointer wide
+  static constexpr std::size_t alignment() { return std::max(alignof(U), alignof(std::pmr::memory_resource*)); }
+  static constexpr std::size_t header_size() { return std::max(alignof(U), sizeof(std::pmr::memory_resource*)); }
+};
+
+/**
+ * @brief `true` for types whose memory comes from `ArenaAllocator`, directly or through their `value_type`.
+ *
+ * Such values cannot outlive the arena they were built in, so arena-backed
+ * decoders must not return them; `Endpoint` rejects those at compile time.
+ */
+template <typename T, typename = void>
+struct is_arena_backed : std::false_type {};
+
+/**
+ * @brief `true` for types whose own `allocator_type` is an `ArenaAllocator`.
+ */
+template <typename T, typename = void>
+struct is_arena_allocated : std::false_type {};
+
+template <typename T>
+struct is_arena_allocated<T, std::void_t<typename T::allocator_type>>
+  : std::is_same<typename T::allocator_type, ArenaAllocator<typename T::allocator_type::value_type>> {};
+
+// a DOM's value_type is the DOM itself, so the recursion stops there
+template <typename T>
+struct is_arena_backed<T, std::void_t<typename T::value_type>>
+  : std::disjunction<is_arena_allocated<T>,
+                     std::conjunction<std::negation<std::is_same<typename T::value_type, T>>,
+                                      is_arena_backed<typename T::value_type>>> {};
+
+/**
+ * @brief String type used by `ArenaJson`.
+ */
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+/**
+ * @brief Object type used by `ArenaJson`.
+ */
+template <typename K, typename V, typename C = std::less<>, typename A = ArenaAllocator<std::pair<const K, V>>>
+using ArenaObject = std::map<K, V, C, A>;
+
+/**
+ * @brief Array type used by `ArenaJson`.
+ */
+template <typename V, typename A = ArenaAllocator<V>>
+using ArenaArray = std::vector<V, A>;
+
+/**
+ * @brief JSON DOM whose nodes and strings are allocated from the current `ArenaScope`.
+ *
+ * Values are only valid inside the decoder they are passed to; copy anything
+ * you need to keep into `T` (or into a plain `nlohmann::json`). Endpoints whose
+ * `T` is itself arena-backed are rejected at compile time (see `is_arena_backed`).
+ */
+using ArenaJson = nlohmann::basic_json<ArenaObject, ArenaArray, ArenaString, bool,
+                                       std::int64_t, std::uint64_t, double, ArenaAllocator,
+                                       nlohmann::adl_serializer, std::vector<std::uint8_t, ArenaAllocator<std::uint8_t>>>;
+
+/**
+ * @brief SAX handler that builds a `Json` DOM from the events of `Json::sax_parse()`.
+ *
+ * Does what `Json::parse()` does internally, but as a handler of our own, so
+ * filters such as `PrunedSax` and `ArenaBinarySax` can sit in front of it.
+ * Duplicate keys keep the last value; syntax errors are rethrown.
+ */
+template <typename Json>
+class JsonDomBuilder {
+public:
+  explicit JsonDomBuilder(Json& result) : result_(result) {}
+
+  bool null() { return add(Json(nullptr)); }
+  bool boolean(bool value) { return add(Json(value)); }
+  bool number_integer(typename Json::number_integer_t value) { return add(Json(value)); }
+  bool number_unsigned(typename Json::number_unsigned_t value) { return add(Json(value)); }
+  bool number_float(typename Json::number_float_t value, const typename Json::string_t&) { return add(Json(value)); }
+  bool string(typename Json::string_t& value) { return add(Json(value)); }
+  bool binary(typename Json::binary_t& value) { return add(Json(std::move(value))); }
+
+  bool start_object(std::size_t) {
+    containers_.push_back(place(Json(Json::value_t::object)));
+    return true;
+  }
+  bool key(typename Json::string_t& name) {
+    member_ = &(*containers_.back())[name];
+    return true;
+  }
+  bool end_object() {
+    containers_.pop_back();
+    return true;
+  }
+  bool start_array(std::size_t) {
+    containers_.push_back(place(Json(Json::value_t::array)));
+    return true;
+  }
+  bool end_array() {
+    containers_.pop_back();
+    return true;
+  }
+
+  template <typename Exception>
+  bool parse_error(std::size_t, const std::string&, const Exception& error) {
+    throw error;
+  }
+
+private:
+  Json& result_;
+  std::vector<Json*> containers_;  ///< Open objects and arrays, innermost last
+  Json* member_ = nullptr;         ///< Slot of the value after the last key
+
+  // open containers never grow while a child is being filled, so these pointers stay valid
+  Json* place(Json&& value) {
+    if (containers_.empty()) {
+      result_ = std::move(value);
+      return &result_;
+    }
+    Json& parent = *containers_.back();
+    if (parent.is_array()) {
+      parent.push_back(std::move(value));
+      return &parent.back();
+    }
+    *member_ = std::move(value);
+    return member_;
+  }
+
+  bool add(Json&& value) {
+    place(std::move(value));
+    return true;
+  }
+};
+
+/**
+ * @brief SAX adapter that feeds events of nlohmann's CBOR/MessagePack readers to an `ArenaJson` handler.
+ *
+ * The binary readers only instantiate for DOMs with `std::string` strings, so
+ * they run as `nlohmann::json` readers and this adapter re-homes each string
+ * into the arena before handing it on, usually to `JsonDomBuilder`. Pruned
+ * parses of every format go through it as well, since `ArenaJson::sax_parse()`
+ * would instantiate those readers too; `PrunedSax` sits in front of it, so only
+ * selected values are copied.
+ */
+template <typename Handler = JsonDomBuilder<ArenaJson>>
+class ArenaBinarySax {
+public:
+  explicit ArenaBinarySax(Handler& next) : builder_(next) {}
+
+  bool null() { return builder_.null(); }
+  bool boolean(bool value) { return builder_.boolean(value); }
+  bool number_integer(std::int64_t value) { return builder_.number_integer(value); }
+  bool number_unsigned(std::uint64_t value) { return builder_.number_unsigned(value); }
+  bool number_float(double value, const std::string& text) {
+    ArenaJson::string_t arena_text(text.data(), text.size());
+    return builder_.number_float(value, arena_text);
+  }
+  bool string(std::string& value) {
+    ArenaJson::string_t arena_value(value.data(), value.size());
+    return builder_.string(arena_value);
+  }
+  bool binary(nlohmann::json::binary_t& value) {
+    ArenaJson::binary_t arena_value(ArenaJson::binary_t::container_type(value.begin(), value.end()));
+    if (value.has_subtype()) {
+      arena_value.set_subtype(value.subtype());
+    }
+    return builder_.binary(arena_value);
+  }
+  bool start_object(std::size_t size) { return builder_.start_object(size); }
+  bool key(std::string& value) {
+    ArenaJson::string_t arena_key(value.data(), value.size());
+    return builder_.key(arena_key);
+  }
+  bool end_object() { return builder_.end_object(); }
+  bool start_array(std::size_t size) { return builder_.start_array(size); }
+  bool end_array() { return builder_.end_array(); }
+  template <typename Exception>
+  bool parse_error(std::size_t position, const std::string& token, const Exception& error) {
+    return builder_.parse_error(position, token, error);
+  }
+
+private:
+  Handler& builder_;
+};
+
+/**
+ * @brief Set of JSON Pointers (RFC 6901) naming the parts of a response an endpoint reads.
+ *
+ * Built once from the pointers and shared by copies, so it is cheap to keep in
+ * an `Endpoint`. An empty selection keeps the whole document.
+ */
+class JsonSelection {
+public:
+  /**
+   * @brief One pointer token in the selection tree.
+   */
+  struct Node {
+    bool whole = false;                                  ///< This value is selected with everything below it
+    std::size_t array_extent = 0;                        ///< One past the highest selected array index
+    std::map<std::string, Node, std::less<>> children;   ///< Selected members or array indices
+
+    const Node* find(std::string_view token) const {
+      auto child = children.find(token);
+      return child == children.end() ? nullptr : &child->second;
+    }
+  };
+
+  JsonSelection() = default;
+
+  /**
+   * @brief Selects the given pointers, e.g. `{"/user/name", "/items/0"}`; `""` selects everything.
+   * @throws JFetchException If a pointer is malformed.
+   */
+  JsonSelection(std::initializer_list<std::string_view> pointers) {
+    for (std::string_view pointer : pointers) {
+      add(pointer);
+    }
+  }
+
+  /**
+   * @copydoc JsonSelection(std::initializer_list<std::string_view>)
+   */
+  explicit JsonSelection(const std::vector<std::string>& pointers) {
+    for (const std::string& pointer : pointers) {
+      add(pointer);
+    }
+  }
+
+  bool empty() const { return !root_; }
+  const Node* root() const { return root_.get(); }
+
+private:
+  std::shared_ptr<Node> root_;
+
+  void add(std::string_view pointer) {
+    if (!pointer.empty() && pointer.front() != '/') {
+      throw JFetchException("Invalid JSON pointer \"" + std::string(pointer) + "\": must start with '/'");
+    }
+    if (!root_) {
+      root_ = std::make_shared<Node>();
+    }
+
+    Node* node = root_.get();
+    while (!pointer.empty()) {
+      pointer.remove_prefix(1);
+      std::size_t end = std::min(pointer.find('/'), pointer.size());
+      std::string token = unescape(pointer.substr(0, end));
+      pointer.remove_prefix(end);
+
+      std::size_t index = 0;
+      auto [last, error] = std::from_chars(token.data(), token.data() + token.size(), index);
+      if (error == std::errc{} && last == token.data() + token.size() && (token.size() == 1 || token[0] != '0')) {
+        node->array_extent = std::max(node->array_extent, index + 1);
+      }
+      node = &node->children[token];
+    }
+    node->whole = true;
+  }
+
+  static std::string unescape(std::string_view token) {
+    std::string out;
+    for (std::size_t i = 0; i < token.size(); ++i) {
+      if (token[i] == '~' && i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1')) {
+        out += token[++i] == '0' ? '~' : '/';
+      } else if (token[i] == '~') {
+        throw JFetchException("Invalid JSON pointer token \"" + std::string(token) + "\": '~' must be followed by 0 or 1");
+      } else {
+        out += token[i];
+      }
+    }
+    return out;
+  }
+};
+
+/**
+ * @brief SAX filter that forwards only the values named by a `JsonSelection`.
+ *
+ * Unselected subtrees are still scanned by the parser but never reach the DOM
+ * builder, so no nodes or strings are allocated for them. Skipped elements of
+ * a partially selected array are replaced by `null` up to the highest selected
+ * index, so selected elements keep their positions.
+ */
+template <typename Json, typename Handler = JsonDomBuilder<Json>>
+class PrunedSax {
+public:
+  using Node = JsonSelection::Node;
+
+  PrunedSax(Handler& next, const JsonSelection& selection) : next_(next), root_(selection.root()) {}
+
+  bool null() { return scalar([this] { return next_.null(); }); }
+  bool boolean(bool value) { return scalar([&] { return next_.boolean(value); }); }
+  bool number_integer(typename Json::number_integer_t value) {
+    return scalar([&] { return next_.number_integer(value); });
+  }
+  bool number_unsigned(typename Json::number_unsigned_t value) {
+    return scalar([&] { return next_.number_unsigned(value); });
+  }
+  bool number_float(typename Json::number_float_t value, const typename Json::string_t& text) {
+    return scalar([&] { return next_.number_float(value, text); });
+  }
+  bool string(typename Json::string_t& value) { return scalar([&] { return next_.string(value); }); }
+  bool binary(typename Json::binary_t& value) { return scalar([&] { return next_.binary(value); }); }
+
+  bool start_object(std::size_t size) { return open(false, [&] { return next_.start_object(size); }); }
+  bool start_array(std::size_t size) { return open(true, [&] { return next_.start_array(size); }); }
+  bool end_object() { return close([this] { return next_.end_object(); }); }
+  bool end_array() { return close([this] { return next_.end_array(); }); }
+
+  bool key(typename Json::string_t& name) {
+    if (skip_depth_ > 0) {
+      return true;
+    }
+    const Node* object = frames_.back();
+    pending_ = object->whole ? object : object->find(std::string_view(name.data(), name.size()));
+    return pending_ ? next_.key(name) : true;
+  }
+
+  template <typename Exception>
+  bool parse_error(std::size_t position, const std::string& token, const Exception& error) {
+    return next_.parse_error(position, token, error);
+  }
+
+private:
+  Handler& next_;
+  const Node* root_;
+  std::vector<const Node*> frames_;           ///< Selection node of each open container
+  std::vector<std::size_t> indices_;          ///< Next element index of each open container
+  std::vector<bool> arrays_;                  ///< Whether each open container is an array
+  const Node* pending_ = nullptr;             ///< Node of the value after the last key
+  std::size_t skip_depth_ = 0;                ///< Nesting depth inside a skipped container
+
+  // selection node of the value that starts now, or nullptr if it is skipped
+  const Node* next_node() {
+    if (frames_.empty()) {
+      return root_;
+    }
+    const Node* parent = frames_.back();
+    if (parent->whole) {
+      return parent;
+    }
+    if (!arrays_.back()) {
+      return std::exchange(pending_, nullptr);
+    }
+
+    std::size_t index = indices_.back()++;
+    char digits[24];
+    auto written = std::to_chars(digits, digits + sizeof(digits), index).ptr;
+    const Node* node = parent->find(std::string_view(digits, static_cast<std::size_t>(written - digits)));
+    if (!node && index < parent->array_extent) {
+      next_.null();
+    }
+    return node;
+  }
+
+  template <typename Forward>
+  bool scalar(Forward forward) {
+    if (skip_depth_ > 0) {
+      return true;
+    }
+    return next_node() ? forward() : true;
+  }
+
+  template <typename Forward>
+  bool open(bool array, Forward forward) {
+    if (skip_depth_ > 0) {
+      ++skip_depth_;
+      return true;
+    }
+    const Node* node = next_node();
+    if (!node) {
+      skip_depth_ = 1;
+      return true;
+    }
+    frames_.push_back(node);
+    indices_.push_back(0);
+    arrays_.push_back(array);
+    return forward();
+  }
+
+  template <typename Forward>
+  bool close(Forward forward) {
+    if (skip_depth_ > 0) {
+      --skip_depth_;
+      return true;
+    }
+    frames_.pop_back();
+    indices_.pop_back();
+    arrays_.pop_back();
+    return forward();
+  }
+};
+
+/**
+ * @brief Wraps a decoder taking `const ArenaJson&`; see `with_arena()`.
+ */
+template <typename F>
+struct ArenaLambda {
+  F decode;  ///< The wrapped decoder
+};
+
+/**
+ * @brief Marks an endpoint decoder as arena-backed.
+ *
+ * The response is parsed into an `ArenaJson` backed by a monotonic arena that is
+ * released in one shot once the decoder returns, instead of freeing nodes one by one.
+ *
+ * @param decoder Callable taking `const ArenaJson&` and returning `T`.
+ */
+template <typename F>
+ArenaLambda<std::decay_t<F>> with_arena(F&& decoder) {
+  return {std::forward<F>(decoder)};
+}
+
+/**
+ * @brief One entry of a declarative field map: a JSON key and the member it fills.
+ */
+template <typename Class, typename Member>
+struct Field {
+  std::string_view key;   ///< JSON object key
+  Member Class::*member;  ///< Destination member
+};
+
+/**
+ * @brief Maps the JSON key `key` to `member`; see `JFETCH_FIELDS`.
+ */
+template <typename Class, typename Member>
+constexpr Field<Class, Member> field(std::string_view key, Member Class::*member) {
+  return {key, member};
+}
+
+/**
+ * @brief Field-to-key mapping of `T`; specialize with `JFETCH_FIELDS`.
+ *
+ * A specialization holds `static constexpr auto fields`, a tuple of `field()`s.
+ */
+template <typename T>
+struct FieldMap;
+
+/**
+ * @brief Whether `T` has a `FieldMap`.
+ */
+template <typename T, typename = void>
+struct HasFieldMap : std::false_type {};
+
+template <typename T>
+struct HasFieldMap<T, std::void_t<decltype(FieldMap<T>::fields)>> : std::true_type {};
+
+/**
+ * @brief Decoder generated from `FieldMap<T>`.
+ *
+ * Walks each JSON object once. Every key is looked up in a perfect hash table
+ * built at compile time from the mapped keys, and its value is written straight
+ * into the member. Unmapped keys are skipped; members whose key is absent keep
+ * their default. Members that have a field map themselves, `std::vector`s of
+ * them and `std::optional`s are decoded recursively; anything else goes
+ * through nlohmann's `get_to()`. Works on `nlohmann::json` and `ArenaJson` alike.
+ */
+template <typename T>
+class FieldDecoder {
+public:
+  /**
+   * @brief Fills `out` from the JSON object `json`.
+   * @throws nlohmann::json::type_error If `json` is not an object or a value has the wrong type.
+   */
+  template <typename Json>
+  static void decode(const Json& json, T& out) {
+    for (const auto& [key, value] : json.template get_ref<const typename Json::object_t&>()) {
+      std::string_view name(key.data(), key.size());
+      std::int16_t index = table.slots[hash(name, table.seed) & (slot_count - 1)];
+      if (index >= 0 && keys[static_cast<std::size_t>(index)] == name) {
+        assigners<Json>[static_cast<std::size_t>(index)](value, out);
+      }
+    }
+  }
+
+private:
+  static constexpr auto& fields = FieldMap<T>::fields;
+  static constexpr std::size_t field_count = std::tuple_size_v<std::decay_t<decltype(FieldMap<T>::fields)>>;
+
+  // four slots per key keep the seed search short; a power of two turns the modulo into a mask
+  static constexpr std::size_t slot_count = [] {
+    std::size_t count = 4;
+    while (count < field_count * 4) {
+      count *= 2;
+    }
+    return count;
+  }();
+
+  struct Table {
+    std::uint32_t seed = 0;
+    std::array<std::int16_t, slot_count> slots{};
+  };
+
+  template <std::size_t... I>
+  static constexpr std::array<std::string_view, field_count> collect_keys(std::index_sequence<I...>) {
+    return {std::get<I>(fields).key...};
+  }
+
+  static constexpr std::array<std::string_view, field_count> keys =
+    collect_keys(std::make_index_sequence<field_count>{});
+
+  static constexpr std::uint32_t hash(std::string_view key, std::uint32_t seed) {
+    std::uint32_t h = 2166136261u ^ seed;
+    for (char c : key) {
+      h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return h ^ (h >> 15);
+  }
+
+  static constexpr Table build_table() {
+    for (std::size_t i = 0; i < field_count; ++i) {
+      for (std::size_t j = i + 1; j < field_count; ++j) {
+        if (keys[i] == keys[j]) {
+          throw std::logic_error("JFETCH_FIELDS maps the same JSON key twice");
+        }
+      }
+    }
+    for (std::uint32_t seed = 0; seed < (1u << 20); ++seed) {
+      Table candidate;
+      candidate.seed = seed;
+      for (std::size_t slot = 0; slot < slot_count; ++slot) {
+        candidate.slots[slot] = -1;
+      }
+      bool collision = false;
+      for (std::size_t i = 0; i < field_count && !collision; ++i) {
+        std::size_t slot = hash(keys[i], seed) & (slot_count - 1);
+        collision = candidate.slots[slot] >= 0;
+        candidate.slots[slot] = static_cast<std::int16_t>(i);
+      }
+      if (!collision) {
+        return candidate;
+      }
+    }
+    throw std::logic_error("no perfect hash found for the JFETCH_FIELDS keys");
+  }
+
+  static constexpr Table table = build_table();
+
+  template <typename Json, typename Member>
+  static void read(const Json& value, Member& target) {
+    if constexpr (HasFieldMap<Member>::value) {
+      FieldDecoder<Member>::decode(value, target);
+    } else if constexpr (IsMappedVector<Member>::value) {
+      const auto& elements = value.template get_ref<const typename Json::array_t&>();
+      target.clear();
+      target.reserve(elements.size());
+      for (const auto& element : elements) {
+        FieldDecoder<typename Member::value_type>::decode(element, target.emplace_back());
+      }
+    } else if constexpr (IsOptional<Member>::value) {
+      if (value.is_null()) {
+        target.reset();
+      } else {
+        read(value, target.emplace());
+      }
+    } else if constexpr (std::is_same_v<Member, std::string>) {
+      // also covers arena strings, which get_to() cannot convert
+      const auto& text = value.template get_ref<const typename Json::string_t&>();
+      target.assign(text.data(), text.size());
+    } else {
+      value.get_to(target);
+    }
+  }
+
+  template <std::size_t I, typename Json>
+  static void assign(const Json& value, T& out) {
+    read(value, out.*(std::get<I>(fields).member));
+  }
+
+  template <typename Json, std::size_t... I>
+  static constexpr std::array<void (*)(const Json&, T&), field_count> make_assigners(std::index_sequence<I...>) {
+    return {&assign<I, Json>...};
+  }
+
+  template <typename Json>
+  static constexpr std::array<void (*)(const Json&, T&), field_count> assigners =
+    make_assigners<Json>(std::make_index_sequence<field_count>{});
+
+  template <typename U>
+  struct IsMappedVector : std::false_type {};
+  template <typename U, typename A>
+  struct IsMappedVector<std::vector<U, A>> : HasFieldMap<U> {};
+
+  template <typename U>
+  struct IsOptional : std::false_type {};
+  template <typename U>
+  struct IsOptional<std::optional<U>> : std::true_type {};
+};
+
+/**
+ * @brief Decodes the JSON object `json` into a new `T` using its `FieldMap`.
+ */
+template <typename T, typename Json>
+T decode_fields(const Json& json) {
+  T out{};
+  FieldDecoder<T>::decode(json, out);
+  return out;
+}
+
+/**
+ * @brief Endpoint decoder generated from `FieldMap<T>`; see `mapped_decoder()`.
+ */
+template <typename T>
+struct MappedDecoder {
+  template <typename Json>
+  T operator()(const Json& json) const {
+    return decode_fields<T>(json);
+  }
+};
+
+/**
+ * @brief Returns a decoder for `T` generated from its field map.
+ *
+ * Use it as a regular decoder, or wrap it in `with_arena()` for arena-backed parsing:
+ * @code
+ * endpoint_lookup["/products/1"] = {jfetch::RequestMethod::GET, jfetch::mapped_decoder<Product>()};
+ * endpoint_lookup["/products/2"] = {jfetch::RequestMethod::GET, jfetch::with_arena(jfetch::mapped_decoder<Product>())};
+ * @endcode
+ */
+template <typename T>
+MappedDecoder<T> mapped_decoder() {
+  return {};
+}
+
+/**
+ * @brief Declares the field map of `Type`; use at global scope.
+ *
+ * Mapping the same JSON key twice is a compile error.
+ * @code
+ * JFETCH_FIELDS(Product, JFETCH_FIELD(id), JFETCH_FIELD(title), jfetch::field("price_usd", &Product::price));
+ * @endcode
+ */
+#define JFETCH_FIELDS(Type, ...)                                  \
+  template <>                                                     \
+  struct jfetch::FieldMap<Type> {                                 \
+    using mapped_type = Type;                                     \
+    static constexpr auto fields = std::make_tuple(__VA_ARGS__);  \
+  }
+
+/**
+ * @brief Maps a member to the JSON key of the same name; use inside `JFETCH_FIELDS`.
+ */
+#define JFETCH_FIELD(member) ::jfetch::field(#member, &mapped_type::member)
+
+/**
+ * @brief HTTP status class used to bucket latency metrics.
+ */
+enum class StatusClass {
+  Informational,  ///< 1xx
+  Success,        ///< 2xx
+  Redirection,    ///< 3xx
+  ClientError,    ///< 4xx
+  ServerError,    ///< 5xx
+  NoResponse,     ///< Transfer failed before a status was received
+};
+
+/**
+ * @brief Number of `StatusClass` values.
+ */
+constexpr std::size_t status_class_count = 6;
+
+/**
+ * @brief Maps an HTTP status code to its `StatusClass`.
+ */
+inline StatusClass status_class_of(long http_status) {
+  if (http_status >= 100 && http_status < 600) {
+    return static_cast<StatusClass>(http_status / 100 - 1);
+  }
+  return StatusClass::NoResponse;
+}
+
+/**
+ * @brief Latency percentiles in microseconds.
+ */
+struct LatencySummary {
+  std::uint64_t count = 0;  ///< Number of samples
+  double mean = 0;          ///< Mean latency
+  std::uint64_t p50 = 0;    ///< Median
+  std::uint64_t p90 = 0;    ///< 90th percentile
+  std::uint64_t p99 = 0;    ///< 99th percentile
+  std::uint64_t p999 = 0;   ///< 99.9th percentile
+  std::uint64_t max = 0;    ///< Largest sample
+};
+
+/**
+ * @brief Point-in-time copy of a `LatencyHistogram`.
+ */
+struct HistogramSnapshot;
+
+/**
+ * @brief Log-linear (HDR-style) histogram of microsecond latencies.
+ *
+ * Values below 32 get exact buckets; above that every power of two is split into
+ * 16 linear sub-buckets (about 6% relative error) up to 2^36 us. Recording is a
+ * handful of relaxed atomic increments, so any number of threads can record
+ * concurrently without a lock.
+ */
+class LatencyHistogram {
+public:
+  static constexpr std::size_t sub_bucket_bits = 4;                          ///< log2(sub-buckets per power of two)
+  static constexpr std::size_t linear_limit = std::size_t{2} << sub_bucket_bits;  ///< Values below this are exact
+  static constexpr std::size_t max_magnitude = 36;                           ///< Values are clamped to 2^36 - 1 us
+  static constexpr std::size_t bucket_count =
+    linear_limit + (max_magnitude - sub_bucket_bits - 1) * (std::size_t{1} << sub_bucket_bits);
+
+  /**
+   * @brief Records one sample.
+   * @param micros Latency in microseconds.
+   */
+  void record(std::uint64_t micros) {
+    micros = std::min<std::uint64_t>(micros, (std::uint64_t{1} << max_magnitude) - 1);
+    counts_[bucket_of(micros)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(micros, std::memory_order_relaxed);
+
+    std::uint64_t seen = max_.load(std::memory_order_relaxed);
+    while (micros > seen && !max_.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * @brief Copies the current counts; concurrent recorders are never blocked.
+   */
+  HistogramSnapshot snapshot() const;
+
+  /**
+   * @brief Returns the number of recorded samples.
+   */
+  std::uint64_t snapshot_count() const { return count_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Returns the bucket a value falls into.
+   */
+  static std::size_t bucket_of(std::uint64_t micros) {
+    if (micros < linear_limit) {
+      return static_cast<std::size_t>(micros);
+    }
+    std::size_t magnitude = most_significant_bit(micros);
+    std::size_t shift = magnitude - sub_bucket_bits;
+    std::size_t sub = static_cast<std::size_t>(micros >> shift) - (std::size_t{1} << sub_bucket_bits);
+    return linear_limit + (magnitude - sub_bucket_bits - 1) * (std::size_t{1} << sub_bucket_bits) + sub;
+  }
+
+  /**
+   * @brief Returns the largest value that maps to `bucket`.
+   */
+  static std::uint64_t bucket_upper_bound(std::size_t bucket) {
+    if (bucket < linear_limit) {
+      return bucket;
+    }
+    std::size_t offset = bucket - linear_limit;
+    std::size_t shift = offset / (std::size_t{1} << sub_bucket_bits) + 1;
+    std::uint64_t sub = offset % (std::size_t{1} << sub_bucket_bits) + (std::uint64_t{1} << sub_bucket_bits);
+    return ((sub + 1) << shift) - 1;
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, bucket_count> counts_{};
+  std::atomic<std::uint64_t> count_{0};
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+
+  static std::size_t most_significant_bit(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - static_cast<std::size_t>(__builtin_clzll(value));
+#else
+    std::size_t bit = 0;
+    while (value >>= 1) {
+      ++bit;
+    }
+    return bit;
+#endif
+  }
+};
+
+struct HistogramSnapshot {
+  std::array<std::uint64_t, LatencyHistogram::bucket_count> counts{};  ///< Samples per bucket
+  std::uint64_t count = 0;                                             ///< Total samples
+  std::uint64_t sum = 0;                                               ///< Sum of samples
+  std::uint64_t max = 0;                                               ///< Largest sample
+
+  /**
+   * @brief Adds another snapshot's samples to this one.
+   */
+  void merge(const HistogramSnapshot& other) {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+  }
+
+  /**
+   * @brief Returns the (bucket upper bound) value at quantile `q` in [0, 1].
+   */
+  std::uint64_t value_at(double q) const {
+    std::uint64_t total = 0;
+    for (std::uint64_t c : counts) {
+      total += c;
+    }
+    if (total == 0) {
+      return 0;
+    }
+
+    std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(total) + 0.5);
+    rank = std::max<std::uint64_t>(rank, 1);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(LatencyHistogram::bucket_upper_bound(i), max);
+      }
+    }
+    return max;
+  }
+
+  /**
+   * @brief Computes the usual percentiles.
+   */
+  LatencySummary summary() const {
+    LatencySummary result;
+    result.count = count;
+    result.mean = count ? static_cast<double>(sum) / static_cast<double>(count) : 0;
+    result.p50 = value_at(0.5);
+    result.p90 = value_at(0.9);
+    result.p99 = value_at(0.99);
+    result.p999 = value_at(0.999);
+    result.max = max;
+    return result;
+  }
+};
+
+inline HistogramSnapshot LatencyHistogram::snapshot() const {
+  HistogramSnapshot result;
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    result.counts[i] = counts_[i].load(std::memory_order_relaxed);
+  }
+  result.count = count_.load(std::memory_order_relaxed);
+  result.sum = sum_.load(std::memory_order_relaxed);
+  result.max = max_.load(std::memory_order_relaxed);
+  return result;
+}
+
+/**
+ * @brief Snapshot of one endpoint's metrics; see `JFetch::metrics_snapshot()`.
+ */
+struct EndpointMetricsSnapshot {
+  std::string endpoint;                                      ///< Endpoint name
+  std::uint64_t requests = 0;                                ///< Completed fetches
+  std::uint64_t failures = 0;                                ///< Fetches that produced a `FetchError`
+  double error_rate = 0;                                     ///< `failures / requests`
+  std::int64_t in_flight = 0;                                ///< Fetches currently running
+  std::uint64_t bytes_in = 0;                                ///< Response body bytes received
+  std::uint64_t bytes_out = 0;                               ///< Request body bytes sent
+  LatencySummary latency;                                    ///< Latency across all status classes
+  std::array<LatencySummary, status_class_count> by_class;   ///< Latency per `StatusClass`
+};
+
+/**
+ * @brief Lock-free latency histograms and counters of one endpoint.
+ */
+class EndpointMetrics {
+public:
+  /**
+   * @brief Marks a fetch as started; pair with `record()`.
+   */
+  void start() {
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Records one completed fetch started with `start()`.
+   * @param http_status HTTP status code (0 if none was received).
+   * @param latency Whole-call latency.
+   * @param failed Whether the fetch produced a `FetchError`.
+   * @param bytes_in Response body bytes received.
+   * @param bytes_out Request body bytes sent.
+   */
+  void record(long http_status, std::chrono::microseconds latency, bool failed,
+              std::size_t bytes_in, std::size_t bytes_out) {
+    std::uint64_t micros = latency.count() > 0 ? static_cast<std::uint64_t>(latency.count()) : 0;
+    by_class_[static_cast<std::size_t>(status_class_of(http_status))].record(micros);
+    if (failed) {
+      failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bytes_in_.fetch_add(bytes_in, std::memory_order_relaxed);
+    bytes_out_.fetch_add(bytes_out, std::memory_order_relaxed);
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns counts, error rate and percentiles.
+   * @param endpoint Name to put in the snapshot.
+   */
+  EndpointMetricsSnapshot snapshot(const std::string& endpoint) const {
+    EndpointMetricsSnapshot result;
+    result.endpoint = endpoint;
+
+    HistogramSnapshot all;
+    for (std::size_t i = 0; i < status_class_count; ++i) {
+      HistogramSnapshot histogram = by_class_[i].snapshot();
+      result.by_class[i] = histogram.summary();
+      all.merge(histogram);
+    }
+
+    result.latency = all.summary();
+    result.requests = all.count;
+    result.failures = std::min(failures(), all.count);
+    result.error_rate = all.count ? static_cast<double>(result.failures) / static_cast<double>(all.count) : 0;
+    result.in_flight = in_flight();
+    result.bytes_in = bytes_in();
+    result.bytes_out = bytes_out();
+    return result;
+  }
+
+  const LatencyHistogram& histogram(StatusClass status_class) const {
+    return by_class_[static_cast<std::size_t>(status_class)];
+  }
+
+  std::uint64_t failures() const { return failures_.load(std::memory_order_relaxed); }
+  std::int64_t in_flight() const { return in_flight_.load(std::memory_order_relaxed); }
+  std::uint64_t bytes_in() const { return bytes_in_.load(std::memory_order_relaxed); }
+  std::uint64_t bytes_out() const { return bytes_out_.load(std::memory_order_relaxed); }
+
+private:
+  std::array<LatencyHistogram, status_class_count> by_class_;
+  std::atomic<std::uint64_t> failures_{0};
+  std::atomic<std::int64_t> in_flight_{0};
+  std::atomic<std::uint64_t> bytes_in_{0};
+  std::atomic<std::uint64_t> bytes_out_{0};
+};
+
+/**
+ * @brief Output format of `JFetch::render_metrics()`.
+ */
+enum class MetricsFormat {
+  Prometheus,  ///< Prometheus text exposition format (0.0.4)
+  Json,        ///< One JSON object with an `endpoints` array and a `connection_pool_idle` object
+};
+
+/**
+ * @brief Idle entries of the connection pools a fetcher draws on, exported as `jfetch_connection_pool_idle`.
+ */
+struct ConnectionPoolIdle {
+  std::size_t libcurl = 0;                ///< `CurlHandlePool::idle()`
+  std::optional<std::size_t> transport;   ///< `Transport::idle()` of a custom transport, if one is set
+};
+
+/**
+ * @brief Serializes `EndpointMetrics` as Prometheus text or JSON.
+ *
+ * Counters are read with relaxed loads and percentiles are computed from
+ * stack-resident histogram copies, so rendering never blocks recorders and the
+ * only heap allocation is growing the output string (none if it is reused).
+ * `ForEach` is called with a visitor taking `(const std::string&, const EndpointMetrics&)`.
+ */
+class MetricsExporter {
+public:
+  /**
+   * @brief Appends all endpoints in Prometheus text format.
+   */
+  template <typename ForEach>
+  static void prometheus(std::string& out, ForEach&& for_each_endpoint, const ConnectionPoolIdle& pools = {}) {
+    family(out, "jfetch_requests_total", "counter", "Completed fetches by HTTP status class.");
+    for_each_endpoint([&out](const std::string& name, const EndpointMetrics& metrics) {
+      for (std::size_t i = 0; i < status_class_count; ++i) {
+        std::uint64_t count = metrics.histogram(static_cast<StatusClass>(i)).snapshot_count();
+        if (count > 0) {
+          sample_prefix(out, "jfetch_requests_total", name);
+          out += ",class=\"";
+          out += class_names[i];
+          out += "\"} ";
+          append_number(out, count);
+          out += '\n';
+        }
+      }
+    });
+
+    per_endpoint(out, "jfetch_failures_total", "counter", "Fetches that produced a FetchError.", for_each_endpoint,
+                 [](const EndpointMetrics& metrics) { return metrics.failures(); });
+    per_endpoint(out, "jfetch_in_flight", "gauge", "Fetches currently running.", for_each_endpoint,
+                 [](const EndpointMetrics& metrics) { return metrics.in_flight(); });
+    per_endpoint(out, "jfetch_received_bytes_total", "counter", "Response body bytes received.", for_each_endpoint,
+                 [](const EndpointMetrics& metrics) { return metrics.bytes_in(); });
+    per_endpoint(out, "jfetch_sent_bytes_total", "counter", "Request body bytes sent.", for_each_endpoint,
+                 [](const EndpointMetrics& metrics) { return metrics.bytes_out(); });
+
+    family(out, "jfetch_request_duration_seconds", "summary", "Whole-call fetch latency.");
+    for_each_endpoint([&out](const std::string& name, const EndpointMetrics& metrics) {
+      HistogramSnapshot all;
+      for (std::size_t i = 0; i < status_class_count; ++i) {
+        all.merge(metrics.histogram(static_cast<StatusClass>(i)).snapshot());
+      }
+      LatencySummary summary = all.summary();
+      static constexpr const char* quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+      const std::uint64_t values[] = {summary.p50, summary.p90, summary.p99, summary.p999};
+      for (std::size_t i = 0; i < 4; ++i) {
+        sample_prefix(out, "jfetch_request_duration_seconds", name);
+        out += ",quantile=\"";
+        out += quantiles[i];
+        out += "\"} ";
+        append_number(out, static_cast<double>(values[i]) / 1e6);
+        out += '\n';
+      }
+      sample_prefix(out, "jfetch_request_duration_seconds_sum", name);
+      out += "} ";
+      append_number(out, static_cast<double>(all.sum) / 1e6);
+      out += '\n';
+      sample_prefix(out, "jfetch_request_duration_seconds_count", name);
+      out += "} ";
+      append_number(out, all.count);
+      out += '\n';
+    });
+
+    family(out, "jfetch_connection_pool_idle", "gauge", "Pooled connections waiting for a request.");
+    out += "jfetch_connection_pool_idle{pool=\"libcurl\"} ";
+    append_number(out, pools.libcurl);
+    out += '\n';
+    if (pools.transport) {
+      out += "jfetch_connection_pool_idle{pool=\"transport\"} ";
+      append_number(out, *pools.transport);
+      out += '\n';
+    }
+  }
+
+  /**
+   * @brief Appends all endpoints as one JSON object.
+   */
+  template <typename ForEach>
+  static void json(std::string& out, ForEach&& for_each_endpoint, const ConnectionPoolIdle& pools = {}) {
+    out += "{\"endpoints\":[";
+    bool first = true;
+    for_each_endpoint([&out, &first](const std::string& name, const EndpointMetrics& metrics) {
+      out += first ? "{" : ",{";
+      first = false;
+
+      HistogramSnapshot all;
+      LatencySummary by_class[status_class_count];
+      for (std::size_t i = 0; i < status_class_count; ++i) {
+        HistogramSnapshot histogram = metrics.histogram(static_cast<StatusClass>(i)).snapshot();
+        by_class[i] = histogram.summary();
+        all.merge(histogram);
+      }
+
+      out += "\"endpoint\":\"";
+      append_json_string(out, name);
+      out += "\",\"requests\":";
+      append_number(out, all.count);
+      out += ",\"failures\":";
+      append_number(out, metrics.failures());
+      out += ",\"error_rate\":";
+      append_number(out, all.count ? static_cast<double>(std::min(metrics.failures(), all.count)) /
+                                       static_cast<double>(all.count) : 0.0);
+      out += ",\"in_flight\":";
+      append_number(out, metrics.in_flight());
+      out += ",\"bytes_in\":";
+      append_number(out, metrics.bytes_in());
+      out += ",\"bytes_out\":";
+      append_number(out, metrics.bytes_out());
+      out += ",\"latency_us\":";
+      append_summary(out, all.summary());
+      out += ",\"by_class\":{";
+      bool first_class = true;
+      for (std::size_t i = 0; i < status_class_count; ++i) {
+        if (by_class[i].count == 0) {
+          continue;
+        }
+        out += first_class ? "\"" : ",\"";
+        first_class = false;
+        out += class_names[i];
+        out += "\":";
+        append_summary(out, by_class[i]);
+      }
+      out += "}}";
+    });
+    out += "],\"connection_pool_idle\":{\"libcurl\":";
+    append_number(out, pools.libcurl);
+    if (pools.transport) {
+      out += ",\"transport\":";
+      append_number(out, *pools.transport);
+    }
+    out += "}}";
+  }
+
+  /**
+   * @brief Rough upper bound of the rendered size per endpoint, used to reserve once.
+   */
+  static constexpr std::size_t bytes_per_endpoint = 2048;
+
+private:
+  static constexpr const char* class_names[status_class_count] = {"1xx", "2xx", "3xx", "4xx", "5xx", "none"};
+
+  static void family(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+  }
+
+  // one sample per endpoint; `type` is "counter" or "gauge"
+  template <typename ForEach, typename Value>
+  static void per_endpoint(std::string& out, const char* name, const char* type, const char* help,
+                           ForEach& for_each_endpoint, Value value) {
+    family(out, name, type, help);
+    for_each_endpoint([&](const std::string& endpoint, const EndpointMetrics& metrics) {
+      sample_prefix(out, name, endpoint);
+      out += "} ";
+      append_number(out, value(metrics));
+      out += '\n';
+    });
+  }
+
+  // writes `name{endpoint="..."` and leaves the label set open
+  static void sample_prefix(std::string& out, const char* name, const std::string& endpoint) {
+    out += name;
+    out += "{endpoint=\"";
+    append_label_value(out, endpoint);
+    out += '"';
+  }
+
+  static void append_summary(std::string& out, const LatencySummary& summary) {
+    out += "{\"count\":";
+    append_number(out, summary.count);
+    out += ",\"mean\":";
+    append_number(out, summary.mean);
+    out += ",\"p50\":";
+    append_number(out, summary.p50);
+    out += ",\"p90\":";
+    append_number(out, summary.p90);
+    out += ",\"p99\":";
+    append_number(out, summary.p99);
+    out += ",\"p999\":";
+    append_number(out, summary.p999);
+    out += ",\"max\":";
+    append_number(out, summary.max);
+    out += '}';
+  }
+
+  // Prometheus label value: only `"`, `\` and newline have escapes, other control characters are dropped
+  static void append_label_value(std::string& out, const std::string& value) {
+    for (char c : value) {
+      switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        default:
+          if (static_cast<unsigned char>(c) >= 0x20) {
+            out += c;
+          }
+      }
+    }
+  }
+
+  // JSON string contents: control characters become `\u00XX`
+  static void append_json_string(std::string& out, const std::string& value) {
+    static constexpr char hex[] = "0123456789abcdef";
+    for (char c : value) {
+      unsigned char byte = static_cast<unsigned char>(c);
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += c;
+      } else if (byte < 0x20) {
+        out += "\\u00";
+        out += hex[byte >> 4];
+        out += hex[byte & 0xf];
+      } else {
+        out += c;
+      }
+    }
+  }
+
+  template <typename Number>
+  static void append_number(std::string& out, Number value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+  }
+};
+
+/**
+ * @brief Epoch-based reclamation for objects read lock-free by many threads and replaced rarely.
+ *
+ * A reader holds a `Guard` while it loads and uses a shared pointer. Pinning
+ * writes only to the calling thread's own slot, so readers take no lock,
+ * never wait and share no written cache line. A writer that replaces an
+ * object passes the old one to `retire()`. It is freed once every reader
+ * pinned before the replacement has left, by the writer itself or by the
+ * last of those readers on its way out.
+ */
+class EpochDomain {
+  struct Slot;
+
+public:
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  ~EpochDomain() {
+    for (Retired& retired : retired_) {
+      retired.destroy(retired.object);
+    }
+    for (Slot* slot = slots_.load(std::memory_order_acquire); slot != nullptr;) {
+      Slot* next = slot->next;
+      delete slot;
+      slot = next;
+    }
+  }
+
+  /**
+   * @brief Returns the process-wide domain.
+   */
+  static EpochDomain& instance() {
+    static EpochDomain domain;
+    return domain;
+  }
+
+  /**
+   * @brief Keeps every object loaded while it exists from being freed; guards nest.
+   */
+  class Guard {
+  public:
+    Guard() : slot_(instance().enter()) {}
+    Guard(Guard&& other) noexcept : slot_(std::exchange(other.slot_, nullptr)) {}
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+    Guard& operator=(Guard&&) = delete;
+
+    ~Guard() {
+      if (slot_) {
+        instance().leave(slot_);
+      }
+    }
+
+  private:
+    Slot* slot_;
+  };
+
+  /**
+   * @brief Frees `object` with `destroy` once no reader that might have loaded it is left.
+   *
+   * Call it after the object has been unlinked, so no new reader can find it.
+   */
+  void retire(const void* object, void (*destroy)(const void*)) {
+    std::uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      retired_.push_back({object, destroy, epoch});
+      pending_.store(true, std::memory_order_relaxed);
+    }
+    collect();
+  }
+
+private:
+  static constexpr std::uint64_t idle = ~std::uint64_t{0};
+
+  // one per thread, padded to a cache line; the list only grows and slots are reused
+  struct alignas(64) Slot {
+    std::atomic<std::uint64_t> epoch{idle};  ///< Epoch the owner pinned, or `idle`
+    std::atomic<bool> owned{false};          ///< Whether a thread holds the slot
+    unsigned depth = 0;                      ///< Nested guards of the owner
+    Slot* next = nullptr;                    ///< Next slot in `slots_`
+  };
+
+  struct Retired {
+    const void* object;
+    void (*destroy)(const void*);
+    std::uint64_t epoch;  ///< Epoch the object was replaced in
+  };
+
+  // gives a slot back when its thread exits
+  struct SlotOwner {
+    Slot* slot;
+    bool& released;
+
+    SlotOwner(Slot* slot, bool& released) : slot(slot), released(released) {}
+
+    ~SlotOwner() {
+      slot->owned.store(false, std::memory_order_release);
+      released = true;
+    }
+  };
+
+  std::atomic<std::uint64_t> epoch_{0};
+  std::atomic<Slot*> slots_{nullptr};
+  std::atomic<bool> pending_{false};  ///< Whether `retired_` may be non-empty
+  std::mutex mutex_;                  ///< Guards `retired_`; readers only ever try it
+  std::vector<Retired> retired_;
+
+  EpochDomain() = default;
+
+  // this thread's slot, or `nullptr` once thread exit has given it back
+  Slot* thread_slot() {
+    static thread_local bool released = false;
+    if (released) {
+      return nullptr;
+    }
+    static thread_local SlotOwner owner(acquire_slot(), released);
+    return owner.slot;
+  }
+
+  Slot* acquire_slot() {
+    for (Slot* slot = slots_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+      bool expected = false;
+      if (!slot->owned.load(std::memory_order_relaxed) &&
+          slot->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        return slot;
+      }
+    }
+    Slot* slot = new Slot;
+    slot->owned.store(true, std::memory_order_relaxed);
+    slot->next = slots_.load(std::memory_order_relaxed);
+    while (!slots_.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return slot;
+  }
+
+  Slot* enter() {
+    // after thread exit (e.g. from a static destructor) a slot is borrowed for this guard alone
+    Slot* slot = thread_slot();
+    if (!slot) {
+      slot = acquire_slot();
+    }
+    if (slot->depth++ == 0) {
+      // the pinned epoch must be visible to writers before the caller loads anything
+      slot->epoch.store(epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+    return slot;
+  }
+
+  void leave(Slot* slot) {
+    if (--slot->depth > 0) {
+      return;
+    }
+    slot->epoch.store(idle, std::memory_order_release);
+    if (slot != thread_slot()) {
+      slot->owned.store(false, std::memory_order_release);
+    }
+    if (pending_.load(std::memory_order_relaxed)) {
+      collect();
+    }
+  }
+
+  // frees what no pinned reader can still see; skips the round if another thread is collecting
+  void collect() {
+    std::vector<Retired> freeable;
+    {
+      std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+      if (!lock) {
+        return;
+      }
+      std::uint64_t oldest = idle;
+      for (Slot* slot = slots_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+        oldest = std::min(oldest, slot->epoch.load(std::memory_order_seq_cst));
+      }
+      auto visible = std::partition(retired_.begin(), retired_.end(),
+                                    [oldest](const Retired& retired) { return retired.epoch >= oldest; });
+      freeable.assign(visible, retired_.end());
+      retired_.erase(visible, retired_.end());
+      pending_.store(!retired_.empty(), std::memory_order_relaxed);
+    }
+    // destructors run unlocked, so they may read through another guard themselves
+    for (Retired& retired : freeable) {
+      retired.destroy(retired.object);
+    }
+  }
+};
+
+/**
+ * @brief Point-in-time view of a `WorkStealingExecutor`, for sizing the pool.
+ */
+struct ExecutorStats {
+  std::vector<std::size_t> queue_depths;  ///< Tasks waiting in each worker's deque
+  std::uint64_t submitted = 0;            ///< Tasks ever submitted
+  std::uint64_t executed = 0;             ///< Tasks run to completion
+  std::uint64_t steals = 0;               ///< Tasks a worker took from another worker's deque
+};
+
+/**
+ * @brief Fixed-size CPU pool with one deque per worker and work stealing.
+ *
+ * Tasks submitted from outside the pool are dealt round-robin across the
+ * workers; tasks submitted from a worker go to its own deque. A worker runs
+ * its own tasks newest-first and, once its deque is empty, steals the oldest
+ * task of another worker, so one long decode never strands work queued behind it.
+ * Exceptions escaping a task are discarded.
+ */
+class WorkStealingExecutor {
+public:
+  using Task = std::function<void()>;  ///< Unit of work
+
+  /**
+   * @brief Starts `workers` threads (at least one).
+   */
+  explicit WorkStealingExecutor(std::size_t workers = std::thread::hardware_concurrency()) {
+    workers = std::max<std::size_t>(workers, 1);
+    workers_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i < workers; ++i) {
+      workers_[i]->thread = std::thread([this, i] { run(i); });
+    }
+  }
+
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  /**
+   * @brief Runs every task still queued, then stops the workers.
+   */
+  ~WorkStealingExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      stopping_ = true;
+    }
+    idle_cv_.notify_all();
+    for (auto& worker : workers_) {
+      worker->thread.join();
+    }
+  }
+
+  /**
+   * @brief Process-wide pool with one worker per hardware thread.
+   */
+  static WorkStealingExecutor& instance() {
+    static WorkStealingExecutor executor;
+    return executor;
+  }
+
+  /**
+   * @brief Queues a task.
+   */
+  void submit(Task task) {
+    std::size_t index = current_worker().first == this
+      ? current_worker().second
+      : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    {
+      std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+      workers_[index]->tasks.push_back(std::move(task));
+    }
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    pending_.fetch_add(1, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    idle_cv_.notify_one();
+  }
+
+  std::size_t worker_count() const { return workers_.size(); }
+
+  /**
+   * @brief Returns queue depths and counters; never blocks running tasks for long.
+   */
+  ExecutorStats stats() const {
+    ExecutorStats result;
+    result.queue_depths.reserve(workers_.size());
+    for (const auto& worker : workers_) {
+      {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        result.queue_depths.push_back(worker->tasks.size());
+      }
+      result.executed += worker->executed.load(std::memory_order_relaxed);
+      result.steals += worker->steals.load(std::memory_order_relaxed);
+    }
+    result.submitted = submitted_.load(std::memory_order_relaxed);
+    return result;
+  }
+
+private:
+  struct Worker {
+    mutable std::mutex mutex;
+    std::deque<Task> tasks;
+    std::atomic<std::uint64_t> executed{0};
+    std::atomic<std::uint64_t> steals{0};
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<std::size_t> next_{0};            ///< Round-robin cursor for external submissions
+  std::atomic<std::size_t> pending_{0};         ///< Queued tasks across all workers
+  std::atomic<std::uint64_t> submitted_{0};
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  bool stopping_ = false;
+
+  /// The executor and worker index the calling thread belongs to, if any.
+  static std::pair<const WorkStealingExecutor*, std::size_t>& current_worker() {
+    thread_local std::pair<const WorkStealingExecutor*, std::size_t> worker{nullptr, 0};
+    return worker;
+  }
+
+  bool pop_local(std::size_t index, Task& task) {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+  }
+
+  bool steal(std::size_t index, Task& task) {
+    for (std::size_t offset = 1; offset < workers_.size(); ++offset) {
+      Worker& victim = *workers_[(index + offset) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        workers_[index]->steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run(std::size_t index) {
+    current_worker() = {this, index};
+    Task task;
+    for (;;) {
+      if (pop_local(index, task) || steal(index, task)) {
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        try {
+          task();
+        } catch (...) {
+        }
+        task = nullptr;
+        workers_[index]->executed.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      idle_cv_.wait(lock, [this] { return stopping_ || pending_.load(std::memory_order_acquire) > 0; });
+      // a stopping pool still finishes its queue, so no fetch_async() promise is left broken
+      if (stopping_ && pending_.load(std::memory_order_acquire) == 0) {
+        return;
+      }
+    }
+  }
+};
+
+/**
+ * @brief Background thread driving a libcurl multi handle.
+ *
+ * Transfers submitted from any thread are added to the multi handle, which
+ * multiplexes their sockets and shares one connection cache. The completion
+ * callback runs on the reactor thread and should only hand the response off
+ * (e.g. to a `WorkStealingExecutor`), so parsing never delays other transfers.
+ * Finished handles go back to `CurlHandlePool`.
+ */
+class IoReactor {
+public:
+  using Completion = std::function<void(CURL*, CURLcode)>;  ///< Called once per finished transfer
+
+  IoReactor() : multi_(curl_multi_init()) {
+    // the pool must outlive the reactor, which returns handles to it until it is destroyed
+    CurlHandlePool::instance();
+    thread_ = std::thread([this] { run(); });
+  }
+
+  IoReactor(const IoReactor&) = delete;
+  IoReactor& operator=(const IoReactor&) = delete;
+
+  /**
+   * @brief Stops the reactor; unfinished transfers complete with `CURLE_ABORTED_BY_CALLBACK`.
+   */
+  ~IoReactor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    curl_multi_wakeup(multi_);
+    thread_.join();
+
+    for (auto& [handle, transfer] : active_) {
+      curl_multi_remove_handle(multi_, handle);
+      transfer.done(handle, CURLE_ABORTED_BY_CALLBACK);
+    }
+    for (Transfer& transfer : submitted_) {
+      transfer.done(transfer.handle.get(), CURLE_ABORTED_BY_CALLBACK);
+    }
+    active_.clear();
+    submitted_.clear();
+    curl_multi_cleanup(multi_);
+  }
+
+  /**
+   * @brief Process-wide reactor.
+   */
+  static IoReactor& instance() {
+    static IoReactor reactor;
+    return reactor;
+  }
+
+  /**
+   * @brief Starts a prepared transfer; `handle` goes back to its pool after `done` returns.
+   */
+  void submit(CurlHandlePool::Handle handle, Completion done) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      submitted_.push_back({std::move(handle), std::move(done)});
+    }
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+    curl_multi_wakeup(multi_);
+  }
+
+  /**
+   * @brief Transfers submitted but not yet completed.
+   */
+  std::size_t in_flight() const { return in_flight_.load(std::memory_order_relaxed); }
+
+private:
+  struct Transfer {
+    CurlHandlePool::Handle handle;
+    Completion done;
+  };
+
+  CURLM* multi_;
+  std::thread thread_;
+  std::mutex mutex_;
+  bool stopping_ = false;
+  std::vector<Transfer> submitted_;                 ///< Waiting to be added; guarded by `mutex_`
+  std::unordered_map<CURL*, Transfer> active_;      ///< Owned by the reactor thread
+  std::atomic<std::size_t> in_flight_{0};
+
+  void run() {
+    std::vector<Transfer> incoming;
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+          return;
+        }
+        incoming.swap(submitted_);
+      }
+      for (Transfer& transfer : incoming) {
+        CURL* handle = transfer.handle.get();
+        active_.emplace(handle, std::move(transfer));
+        curl_multi_add_handle(multi_, handle);
+      }
+      incoming.clear();
+
+      int running = 0;
+      curl_multi_perform(multi_, &running);
+
+      int queued = 0;
+      while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+        if (message->msg != CURLMSG_DONE) {
+          continue;
+        }
+        CURL* handle = message->easy_handle;
+        CURLcode code = message->data.result;
+        curl_multi_remove_handle(multi_, handle);
+        auto entry = active_.find(handle);
+        Transfer transfer = std::move(entry->second);
+        active_.erase(entry);
+        transfer.done(handle, code);
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+      }
+
+      curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+    }
+  }
+};
+
+/**
+ * @brief An endpoint's HTTP method and decoding logic.
+ * @tparam T The return type expected after JSON processing.
+ */
+template <typename T>
+struct Endpoint {
+  using Decoder = std::function<T(const nlohmann::json&)>;       ///< Decoder over the regular DOM
+  using ArenaDecoder = std::function<T(const ArenaJson&)>;       ///< Decoder over an arena-backed DOM
+
+  Endpoint() = default;
+
+  /**
+   * @brief Constructs an endpoint decoded from a regular `nlohmann::json`.
+   */
+  Endpoint(RequestMethod method, Decoder decoder)
+    : method(method), decoder(std::move(decoder)) {}
+
+  /**
+   * @brief Constructs an endpoint decoded from an `ArenaJson`; see `with_arena()`.
+   */
+  template <typename F>
+  Endpoint(RequestMethod method, ArenaLambda<F> decoder)
+    : method(method), arena_decoder(std::move(decoder.decode)) {
+    static_assert(!is_arena_backed<T>::value,
+                  "an arena-backed decoder cannot return arena memory; copy it into a heap-backed type");
+  }
+
+  RequestMethod method = RequestMethod::GET;  ///< HTTP method
+  Decoder decoder;                            ///< Set for regular endpoints
+  ArenaDecoder arena_decoder;                 ///< Set for arena-backed endpoints
+  bool accept_compressed = false;             ///< Negotiate gzip/brotli/zstd responses (`Accept-Encoding`)
+  RequestCompression request_compression;     ///< Compression of large request bodies
+  WireFormat format = WireFormat::Json;       ///< Preferred response format, sent as `Accept`
+  JsonSelection select;                       ///< JSON Pointers the decoder reads; the rest is never built
+  /**
+   * @brief Latency histograms, shared by copies of this endpoint.
+   */
+  std::shared_ptr<EndpointMetrics> metrics = std::make_shared<EndpointMetrics>();
+};
+
+/**
+ * @brief Default tracing policy of `JFetch`: every hook is an empty inline function.
+ *
+ * Derive from it, set `enabled` to `true` and hide the hooks you need:
+ * @code
+ * struct MyTracer : jfetch::NullTracer {
+ *   static constexpr bool enabled = true;
+ *   void on_complete(std::string_view endpoint, time_point at, const jfetch::FetchError* error) { ... }
+ * };
+ * class MyFetcher : public jfetch::JFetch<Product, MyTracer> { ... };
+ * @endcode
+ * With `enabled == false` no timestamps are taken and the hooks compile away.
+ * Network hooks (`on_dns`, `on_connect`, `on_first_byte`) fire when the transfer
+ * finishes, carrying the time at which each phase ended.
+ */
+struct NullTracer {
+  using time_point = std::chrono::steady_clock::time_point;  ///< Timestamp type passed to hooks
+
+  static constexpr bool enabled = false;  ///< Whether `JFetch` calls the hooks at all
+
+  void on_request_start(std::string_view, time_point) {}
+  void on_dns(std::string_view, time_point) {}
+  void on_connect(std::string_view, time_point) {}
+  void on_first_byte(std::string_view, time_point) {}
+  void on_parse_start(std::string_view, time_point) {}
+  void on_decode_end(std::string_view, time_point) {}
+  void on_complete(std::string_view, time_point, const FetchError*) {}
+
+  /**
+   * @brief Adds trace-context headers (e.g. `traceparent`) via `client.add_header()`.
+   */
+  void inject_headers(std::string_view, HttpClient&) {}
+};
+
+/**
+ * @brief Main template class for interfacing with JSON HTTP endpoints.
+ * @tparam T The return type expected after JSON processing.
+ * @tparam Tracer Tracing policy; see `NullTracer`.
+ */
+template <typename T, typename Tracer = NullTracer>
+class JFetch {
+public:
+  /**
+   * @brief Virtual Destructor
+   */
+  virtual ~JFetch() {
+    // fetch_async() completions call back into this fetcher; wait for the last one
+    {
+      std::unique_lock<std::mutex> lock(async_mutex_);
+      async_idle_.wait(lock, [this] { return async_pending_ == 0; });
+    }
+    delete snapshot_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Sends/Fetches a request to a specified endpoint and parses the JSON response into `T`.
+   *
+   * @param endpoint Name of the registered endpoint.
+   * @param query_params Optional URL query parameters.
+   * @param custom_headers Optional headers specific to this request.
+   * @param custom_body Optional body payload; borrowed unless moved in (see `RequestBody`).
+   * @param stats Optional; receives the timing breakdown of this call.
+   * @return Parsed object of type `T`.
+   *
+   * @throws JFetchException On initialization or CURL failure.
+   * @throws JFetchHTTPException On HTTP error response.
+   * @throws JFetchParsingException On JSON parse failure.
+   * @throws JFetchEndpointNotFoundException If endpoint isn't registered.
+   */
+  T fetch(const std::string& endpoint,
+      const std::unordered_map<std::string, std::string>& query_params = {},
+      const std::vector<std::string>& custom_headers = {},
+      RequestBody custom_body = {},
+      FetchStats* stats = nullptr) {
+    return try_fetch(endpoint, query_params, custom_headers, std::move(custom_body), stats).value();
+  }
+
+  /**
+   * @brief Same as `fetch()`, but reports failures as a `FetchError` instead of throwing.
+   *
+   * Exceptions thrown by the decoder are captured too: `JFetchParsingException`
+   * maps to `FetchErrorCode::Parse`, anything else to `FetchErrorCode::Decode`.
+   * `error().raise()` rethrows exactly what `fetch()` would have thrown.
+   *
+   * @param endpoint Name of the registered endpoint.
+   * @param query_params Optional URL query parameters.
+   * @param custom_headers Optional headers specific to this request.
+   * @param custom_body Optional body payload; borrowed unless moved in (see `RequestBody`).
+   * @param stats Optional; receives the timing breakdown of this call.
+   * @return Parsed object of type `T`, or the error.
+   */
+  Expected<T> try_fetch(const std::string& endpoint,
+      const std::unordered_map<std::string, std::string>& query_params = {},
+      const std::vector<std::string>& custom_headers = {},
+      RequestBody custom_body = {},
+      FetchStats* stats = nullptr) {
+    // frozen fetchers read one immutable snapshot for the whole call, pinned until it returns
+    PinnedSnapshot frozen = load_snapshot();
+    const auto& endpoints = frozen ? frozen->endpoints : endpoint_lookup;
+    const auto& headers = frozen ? frozen->headers : global_headers;
+    const auto& sink = frozen ? frozen->sink : metrics_sink;
+
+    // the detailed breakdown is only collected when someone is going to look at it
+    FetchStats local_stats;
+    FetchStats* current = stats ? stats : (sink || Tracer::enabled) ? &local_stats : nullptr;
+    if (current) {
+      *current = FetchStats{};
+    }
+    auto started = std::chrono::steady_clock::now();
+    if constexpr (Tracer::enabled) {
+      tracer.on_request_start(endpoint, started);
+    }
+    JFETCH_PROBE1(fetch__start, endpoint.c_str());
+
+    // chunked body: slab chunks are returned to the allocator when try_fetch() exits
+    ChunkedBuffer raw_json;
+
+    std::string full_url = build_url(endpoint, query_params);
+
+    // use the provided body, otherwise fallback to the default body
+    RequestBody body = custom_body.empty() ? RequestBody(get_body()) : std::move(custom_body);
+
+    // get request method from the endpoint lookup table
+    auto target = endpoints.find(endpoint);
+    if (target == endpoints.end()) {
+      Expected<T> missing = FetchError::endpoint_not_found(endpoint);
+      complete(endpoint, nullptr, sink, started, 0, &missing.error(), 0, 0, current);
+      return missing;
+    }
+
+    EndpointMetrics& metrics = *target->second.metrics;
+    metrics.start();
+
+    // global and custom headers go straight into the request's header list
+    HttpClient client(full_url, target->second.method, headers, std::move(body));
+    client.add_headers(custom_headers);
+    client.set_unix_socket(get_unix_socket());
+    client.set_accept_compressed(target->second.accept_compressed);
+    if (target->second.format != WireFormat::Json) {
+      client.add_header(accept_header(target->second.format));
+    }
+    client.compress_body(target->second.request_compression, current);
+    if constexpr (Tracer::enabled) {
+      tracer.inject_headers(endpoint, client);
+    }
+
+    TransferResult transfer;
+    Expected<T> outcome = execute(client, target->second, raw_json, transfer, current,
+                                  frozen ? frozen->transport.get() : transport.get());
+
+    complete(endpoint, &metrics, sink, started, transfer.http_status, outcome ? nullptr : &outcome.error(),
+             raw_json.size(), client.body_bytes(), current);
+    return outcome;
+  }
+
+  /**
+   * @brief Streams a top-level JSON array response, decoding and delivering one element at a time.
+   *
+   * The endpoint's decoder (and its `select`) is applied to each element rather
+   * than to the whole body, and `callback` receives each `T` as soon as its
+   * element has arrived, while the rest is still downloading. Only about one
+   * element's text and DOM are in memory at once, whatever the array's length.
+   * `callback` may return `bool`; `false` stops the fetch and abandons the rest
+   * of the body. The response is always requested as text JSON. With a custom
+   * transport the body is received whole first and then split the same way.
+   *
+   * @param endpoint Name of the registered endpoint.
+   * @param callback Invoked with each decoded element (`T&&`), in order.
+   * @param query_params Optional URL query parameters.
+   * @param custom_headers Optional headers specific to this request.
+   * @param custom_body Optional body payload; borrowed unless moved in (see `RequestBody`).
+   * @param stats Optional; `parse` and `decode` add up over all elements and overlap `transfer`.
+   * @return Number of elements delivered to `callback`.
+   *
+   * @throws Whatever `fetch()` would throw; a malformed or truncated array throws
+   *         `JFetchParsingException`, and an exception from `callback` is rethrown as is.
+   */
+  template <typename Callback>
+  std::size_t fetch_each(const std::string& endpoint,
+      Callback&& callback,
+      const std::unordered_map<std::string, std::string>& query_params = {},
+      const std::vector<std::string>& custom_headers = {},
+      RequestBody custom_body = {},
+      FetchStats* stats = nullptr) {
+    return try_fetch_each(endpoint, std::forward<Callback>(callback), query_params, custom_headers,
+                          std::move(custom_body), stats).value();
+  }
+
+  /**
+   * @brief Same as `fetch_each()`, but reports failures as a `FetchError` instead of throwing.
+   *
+   * Elements delivered before a failure stay delivered. An exception thrown by
+   * `callback` stops the fetch and is captured like a decoder exception.
+   */
+  template <typename Callback>
+  Expected<std::size_t> try_fetch_each(const std::string& endpoint,
+      Callback&& callback,
+      const std::unordered_map<std::string, std::string>& query_params = {},
+      const std::vector<std::string>& custom_headers = {},
+      RequestBody custom_body = {},
+      FetchStats* stats = nullptr) {
+    PinnedSnapshot frozen = load_snapshot();
+    const auto& endpoints = frozen ? frozen->endpoints : endpoint_lookup;
+    const auto& headers = frozen ? frozen->headers : global_headers;
+    const auto& sink = frozen ? frozen->sink : metrics_sink;
+
+    FetchStats local_stats;
+    FetchStats* current = stats ? stats : (sink || Tracer::enabled) ? &local_stats : nullptr;
+    if (current) {
+      *current = FetchStats{};
+    }
+    auto started = std::chrono::steady_clock::now();
+    if constexpr (Tracer::enabled) {
+      tracer.on_request_start(endpoint, started);
+    }
+    JFETCH_PROBE1(fetch__start, endpoint.c_str());
+
+    std::string full_url = build_url(endpoint, query_params);
+    RequestBody body = custom_body.empty() ? RequestBody(get_body()) : std::move(custom_body);
+
+    auto target = endpoints.find(endpoint);
+    if (target == endpoints.end()) {
+      Expected<std::size_t> missing = FetchError::endpoint_not_found(endpoint);
+      complete(endpoint, nullptr, sink, started, 0, &missing.error(), 0, 0, current);
+      return missing;
+    }
+
+    EndpointMetrics& metrics = *target->second.metrics;
+    metrics.start();
+
+    HttpClient client(full_url, target->second.method, headers, std::move(body));
+    client.add_headers(custom_headers);
+    client.set_unix_socket(get_unix_socket());
+    client.set_accept_compressed(target->second.accept_compressed);
+    client.compress_body(target->second.request_compression, current);
+    if constexpr (Tracer::enabled) {
+      tracer.inject_headers(endpoint, client);
+    }
+
+    // the first decoder or callback failure stops the transfer and becomes the outcome
+    std::optional<FetchError> failure;
+    const Endpoint<T>& element_target = target->second;
+    JsonArraySplitter splitter([&](std::string_view element) {
+      try {
+        T value = decode(element_target, element, current);
+        if constexpr (std::is_void_v<std::invoke_result_t<Callback&, T&&>>) {
+          callback(std::move(value));
+          return true;
+        } else {
+          return static_cast<bool>(callback(std::move(value)));
+        }
+      } catch (const JFetchParsingException&) {
+        failure = FetchError::from_exception(FetchErrorCode::Parse, std::current_exception());
+      } catch (...) {
+        failure = FetchError::from_exception(FetchErrorCode::Decode, std::current_exception());
+      }
+      return false;
+    });
+
+    TransferResult transfer;
+    if (Transport* custom = frozen ? frozen->transport.get() : transport.get()) {
+      // transports hand over whole bodies; elements are still decoded one at a time
+      ChunkedBuffer raw_json;
+      transfer = custom->perform(client, raw_json, current);
+      if (transfer.ok()) {
+        raw_json.for_each_segment([&splitter](const char* data, std::size_t length) { splitter.append(data, length); });
+      }
+    } else {
+      transfer = client.perform(splitter, current);
+    }
+
+    // when the callback stops early, the aborted transfer is not an error
+    Expected<std::size_t> outcome = splitter.elements();
+    if (failure) {
+      outcome = std::move(*failure);
+    } else if (!splitter.stopped()) {
+      // a malformed array aborts the transfer too; report the array, not the abort
+      if (!transfer.ok() && !splitter.halted()) {
+        outcome = FetchError::from_transfer(transfer);
+      } else {
+        outcome = try_finish(splitter);
+      }
+    }
+
+    complete(endpoint, &metrics, sink, started, transfer.http_status, outcome ? nullptr : &outcome.error(),
+             splitter.size(), client.body_bytes(), current);
+    return outcome;
+  }
+
+  /**
+   * @brief Starts a fetch and returns immediately.
+   *
+   * The transfer runs on the shared `IoReactor` thread. Once the response has
+   * arrived, parsing and the endpoint's decoder run on the executor (see
+   * `set_executor()`), so a heavy decoder never holds up other transfers.
+   * Failures are delivered through the future as the exceptions `fetch()`
+   * would throw. Destroying the fetcher waits until every fetch it started
+   * has completed.
+   *
+   * @param endpoint Name of the registered endpoint.
+   * @param query_params Optional URL query parameters.
+   * @param custom_headers Optional headers specific to this request.
+   * @param custom_body Optional body payload; a borrowed body is copied.
+   * @return Future for the parsed object of type `T`.
+   */
+  std::future<T> fetch_async(const std::string& endpoint,
+      const std::unordered_map<std::string, std::string>& query_params = {},
+      const std::vector<std::string>& custom_headers = {},
+      RequestBody custom_body = {}) {
+    PinnedSnapshot frozen = load_snapshot();
+    const auto& endpoints = frozen ? frozen->endpoints : endpoint_lookup;
+    const auto& headers = frozen ? frozen->headers : global_headers;
+
+    auto started = std::chrono::steady_clock::now();
+    if constexpr (Tracer::enabled) {
+      tracer.on_request_start(endpoint, started);
+    }
+    JFETCH_PROBE1(fetch__start, endpoint.c_str());
+
+    std::promise<T> promise;
+    std::future<T> future = promise.get_future();
+
+    auto target = endpoints.find(endpoint);
+    if (target == endpoints.end()) {
+      FetchError missing = FetchError::endpoint_not_found(endpoint);
+      FetchStats stats;
+      complete(endpoint, nullptr, frozen ? frozen->sink : metrics_sink, started, 0, &missing, 0, 0, &stats);
+      promise.set_exception(missing.to_exception_ptr());
+      return future;
+    }
+
+    // everything the transfer refers to lives here until the decode task is done
+    RequestBody body = custom_body.empty() ? RequestBody(get_body()) : std::move(custom_body);
+    body.own();
+    auto state = std::make_shared<AsyncFetch>(*this, build_url(endpoint, query_params), target->second, headers,
+                                              std::move(body));
+    state->endpoint = endpoint;
+    state->sink = frozen ? frozen->sink : metrics_sink;
+    state->started = started;
+    state->promise = std::move(promise);
+    state->client.add_headers(custom_headers);
+    state->client.set_unix_socket(get_unix_socket());
+    if constexpr (Tracer::enabled) {
+      tracer.inject_headers(endpoint, state->client);
+    }
+    state->target.metrics->start();
+
+    CurlHandlePool::Handle handle = CurlHandlePool::instance().acquire();
+    if (!handle) {
+      TransferResult transfer;
+      transfer.curl_code = CURLE_FAILED_INIT;
+      fail_async(*state, transfer);
+      return future;
+    }
+    state->client.prepare(handle.get(), state->output);
+    JFETCH_PROBE1(request__start, state->endpoint.c_str());
+
+    // resolved before the reactor is first created, so the default pool outlives it
+    WorkStealingExecutor* pool = &executor();
+    IoReactor::instance().submit(std::move(handle), [this, pool, state](CURL* finished, CURLcode code) {
+      TransferResult transfer = state->client.finish(finished, code, state->output);
+      if (!transfer.ok()) {
+        fail_async(*state, transfer);
+        return;
+      }
+      pool->submit([this, state, transfer] {
+        Expected<T> outcome = try_decode(state->target, state->response, &state->stats, transfer.format);
+        complete(state->endpoint, state->target.metrics.get(), state->sink, state->started, transfer.http_status,
+                 outcome ? nullptr : &outcome.error(), state->response.size(), state->client.body_bytes(), &state->stats);
+        if (outcome) {
+          state->promise.set_value(std::move(*outcome));
+        } else {
+          state->promise.set_exception(outcome.error().to_exception_ptr());
+        }
+      });
+    });
+    return future;
+  }
+
+  /**
+   * @brief Sets the pool that parses and decodes `fetch_async()` responses.
+   *
+   * Defaults to `WorkStealingExecutor::instance()`. Set it before the first
+   * `fetch_async()`; it is not synchronized with fetches in flight.
+   *
+   * @param executor Pool to use (`nullptr` restores the default).
+   */
+  void set_executor(std::shared_ptr<WorkStealingExecutor> executor) {
+    executor_ = std::move(executor);
+  }
+
+  /**
+   * @brief Sets global headers applied to all requests.
+   *
+   * Safe to call while other threads are fetching once the fetcher is frozen.
+   *
+   * @param headers List of HTTP headers.
+   */
+  void set_global_headers(const std::vector<std::string>& headers) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    global_headers = headers;
+    republish();
+  }
+
+  /**
+   * @brief Registers or replaces an endpoint.
+   *
+   * Safe to call while other threads are fetching once the fetcher is frozen.
+   * A replaced endpoint starts with the metrics of the `Endpoint` passed in.
+   *
+   * @param name Endpoint path, as passed to `fetch()`.
+   * @param target HTTP method and decoder.
+   */
+  void set_endpoint(const std::string& name, Endpoint<T> target) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    endpoint_lookup.insert_or_assign(name, std::move(target));
+    republish();
+  }
+
+  /**
+   * @brief Replaces the transport used by `fetch()` and `try_fetch()`.
+   *
+   * Safe to call while other threads are fetching once the fetcher is frozen.
+   * `fetch_async()` always runs on the libcurl reactor.
+   *
+   * @param replacement Transport to use (`nullptr` restores libcurl).
+   */
+  void set_transport(std::shared_ptr<Transport> replacement) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    transport = std::move(replacement);
+    republish();
+  }
+
+  /**
+   * @brief Switches the fetcher into thread-safe mode.
+   *
+   * Copies `endpoint_lookup`, `global_headers`, `metrics_sink` and `transport` into an
+   * immutable snapshot that every later `fetch()`/`try_fetch()` reads without a
+   * lock: it pins the snapshot in its thread's `EpochDomain` slot and loads one
+   * atomic pointer, so readers never wait on the writer or on each other. From then on any number of threads may fetch concurrently,
+   * and configuration must change only through `set_global_headers()`,
+   * `set_endpoint()`, `set_metrics_sink()` and `set_transport()`, which copy the snapshot, modify
+   * the copy and publish it atomically; in-flight fetches finish on the
+   * snapshot they started with. Endpoint metrics are shared between snapshots.
+   *
+   * A superseded snapshot is freed once every fetch that started before the
+   * change has returned. Every change copies the whole configuration, so frozen
+   * configuration is meant to change occasionally (e.g. token rotation), not
+   * per request. A non-default `Tracer` must itself be safe to call concurrently.
+   */
+  void freeze() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    publish();
+  }
+
+  /**
+   * @brief Whether `freeze()` has been called.
+   */
+  bool frozen() const {
+    return snapshot_.load(std::memory_order_acquire) != nullptr;
+  }
+
+  /**
+   * @brief Returns request counts, error rates and latency percentiles for every endpoint.
+   *
+   * Histograms are recorded lock-free by every `fetch()`/`try_fetch()` and read
+   * with relaxed loads, so taking a snapshot never blocks fetching threads.
+   */
+  std::vector<EndpointMetricsSnapshot> metrics_snapshot() const {
+    PinnedSnapshot frozen = load_snapshot();
+    const auto& endpoints = frozen ? frozen->endpoints : endpoint_lookup;
+    std::vector<EndpointMetricsSnapshot> result;
+    result.reserve(endpoints.size());
+    for (const auto& [name, target] : endpoints) {
+      result.push_back(target.metrics->snapshot(name));
+    }
+    return result;
+  }
+
+  /**
+   * @brief Appends every endpoint's counters and latency percentiles, and the idle pooled connections, to `out`.
+   *
+   * Reuse `out` across scrapes to avoid allocating at all; otherwise it is
+   * reserved once up front.
+   *
+   * @param out Buffer to append to.
+   * @param format Prometheus text or JSON.
+   */
+  void render_metrics(std::string& out, MetricsFormat format = MetricsFormat::Prometheus) const {
+    PinnedSnapshot frozen = load_snapshot();
+    const auto& endpoints = frozen ? frozen->endpoints : endpoint_lookup;
+    out.reserve(out.size() + MetricsExporter::bytes_per_endpoint * (endpoints.size() + 1));
+    auto for_each_endpoint = [&endpoints](auto&& visitor) {
+      for (const auto& [name, target] : endpoints) {
+        visitor(name, *target.metrics);
+      }
+    };
+    ConnectionPoolIdle pools;
+    pools.libcurl = CurlHandlePool::instance().idle();
+    if (Transport* custom = frozen ? frozen->transport.get() : transport.get()) {
+      pools.transport = custom->idle();
+    }
+    if (format == MetricsFormat::Json) {
+      MetricsExporter::json(out, for_each_endpoint, pools);
+    } else {
+      MetricsExporter::prometheus(out, for_each_endpoint, pools);
+    }
+  }
+
+  /**
+   * @brief Sets the sink that receives the `FetchStats` of every fetch.
+   * @param sink Metrics sink (`nullptr` to disable).
+   */
+  void set_metrics_sink(std::shared_ptr<MetricsSink> sink) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    metrics_sink = std::move(sink);
+    republish();
+  }
+
+protected:
+  /**
+   * @brief Returns the base URL for all requests.
+   * @return Base URL as a string.
+   */
+  virtual std::string get_base() const = 0;
+  /**
+   * @brief Returns a default request body.
+   * @return Body string (default is empty).
+   */
+  virtual std::string get_body() const { return ""; }
+  /**
+   * @brief Returns the Unix domain socket through which `get_base()` is reached.
+   *
+   * Override for sidecars listening on a socket file: the URL still supplies
+   * the path and Host header, but the connection goes to this socket.
+   *
+   * @return Socket path (default is empty, meaning TCP).
+   */
+  virtual std::string get_unix_socket() const { return ""; }
+
+  /**
+   * @brief Reports the phases of a finished fetch to the tracer.
+   *
+   * Phase ends are reconstructed backwards from `finished` using the measured
+   * durations, so all timestamps share the steady clock of `on_request_start`.
+   */
+  void trace_phases(std::string_view endpoint, const FetchStats& stats,
+                    std::chrono::steady_clock::time_point finished, const FetchError* error) {
+    auto decode_end = finished;
+    auto parse_start = decode_end - stats.decode - stats.parse;
+    auto first_byte = parse_start - stats.transfer;
+    auto transfer_start = first_byte - stats.first_byte - stats.tls - stats.connect - stats.dns;
+
+    tracer.on_dns(endpoint, transfer_start + stats.dns);
+    tracer.on_connect(endpoint, transfer_start + stats.dns + stats.connect);
+    tracer.on_first_byte(endpoint, first_byte);
+    if (stats.http_status >= 200 && stats.http_status < 300) {
+      tracer.on_parse_start(endpoint, parse_start);
+      tracer.on_decode_end(endpoint, decode_end);
+    }
+    tracer.on_complete(endpoint, finished, error);
+  }
+
+  /**
+   * @brief Builds the request URL from the base, endpoint and query parameters.
+   */
+  std::string build_url(const std::string& endpoint,
+                        const std::unordered_map<std::string, std::string>& query_params) const {
+    std::string full_url = get_base() + endpoint;
+    if (!query_params.empty()) {
+      full_url += "?";
+      for (const auto& [key, value] : query_params) {
+        full_url += key + "=" + value + "&";
+      }
+      full_url.pop_back();  // remove the trailing '&'
+    }
+    return full_url;
+  }
+
+  /**
+   * @brief Records a finished fetch in the endpoint metrics, probes, tracer and sink.
+   * @param metrics The endpoint's metrics, or `nullptr` if the endpoint is not registered: nothing
+   *                was sent then, so the tracer only gets `on_complete()`.
+   */
+  void complete(const std::string& endpoint, EndpointMetrics* metrics, const std::shared_ptr<MetricsSink>& sink,
+                std::chrono::steady_clock::time_point started, long http_status, const FetchError* error,
+                std::size_t bytes_in, std::size_t bytes_out, FetchStats* stats) {
+    auto finished = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(finished - started);
+    if (metrics) {
+      metrics->record(http_status, elapsed, error != nullptr, bytes_in, bytes_out);
+    }
+    JFETCH_PROBE4(fetch__done, endpoint.c_str(), http_status,
+                  static_cast<long long>(elapsed.count()), static_cast<int>(error != nullptr));
+
+    if constexpr (Tracer::enabled) {
+      if (metrics) {
+        trace_phases(endpoint, *stats, finished, error);
+      } else {
+        tracer.on_complete(endpoint, finished, error);
+      }
+    }
+
+    if (stats) {
+      stats->total = elapsed;
+      if (sink) {
+        sink->record(endpoint, *stats, error);
+      }
+    }
+  }
+
+  /**
+   * @brief Performs the transfer and decodes the response, capturing every failure.
+   */
+  static Expected<T> execute(const HttpClient& client, const Endpoint<T>& target,
+                             ChunkedBuffer& body, TransferResult& result, FetchStats* stats,
+                             Transport* transport = nullptr) {
+    result = transport ? transport->perform(client, body, stats) : client.perform(body, stats);
+    if (!result.ok()) {
+      return FetchError::from_transfer(result);
+    }
+    return try_decode(target, body, stats, result.format);
+  }
+
+  /**
+   * @brief Checks that a `fetch_each()` body was one complete array, returning the element count.
+   */
+  static Expected<std::size_t> try_finish(const JsonArraySplitter& splitter) {
+    try {
+      splitter.finish();
+      return splitter.elements();
+    } catch (const JFetchParsingException&) {
+      return FetchError::from_exception(FetchErrorCode::Parse, std::current_exception());
+    }
+  }
+
+  /**
+   * @brief Runs `decode()`, turning exceptions into `FetchError`s.
+   */
+  static Expected<T> try_decode(const Endpoint<T>& target, const ChunkedBuffer& body, FetchStats* stats,
+                                WireFormat format = WireFormat::Json) {
+    try {
+      return decode(target, body, stats, format);
+    } catch (const JFetchParsingException&) {
+      return FetchError::from_exception(FetchErrorCode::Parse, std::current_exception());
+    } catch (...) {
+      return FetchError::from_exception(FetchErrorCode::Decode, std::current_exception());
+    }
+  }
+
+  /**
+   * @brief Parses a response body in the given format and runs the endpoint's decoder on it.
+   * @tparam Body `ChunkedBuffer`, or `std::string_view` for one element of `fetch_each()`.
+   */
+  template <typename Body>
+  static T decode(const Endpoint<T>& target, const Body& body, FetchStats* stats = nullptr,
+                  WireFormat format = WireFormat::Json) {
+    if (!target.arena_decoder) {
+      PhaseTimer parse_timer(stats ? &stats->parse : nullptr);
+      JFETCH_PROBE1(parse__start, body.size());
+      nlohmann::json json_data = parse_body<nlohmann::json>(body, format, target.select);
+      JFETCH_PROBE1(parse__done, body.size());
+      parse_timer.stop();
+
+      PhaseTimer decode_timer(stats ? &stats->decode : nullptr);
+      return target.decoder(json_data);
+    }
+
+    // the DOM is usually a small multiple of the text size; size the first block accordingly, up to
+    // 1 MiB so a large body is not doubled up front (a pruned DOM can be far smaller, so it starts small)
+    std::pmr::monotonic_buffer_resource arena(
+      target.select.empty() ? std::min<std::size_t>(body.size() * 2 + 4096, 1 << 20) : 4096);
+    ArenaScope scope(&arena);
+
+    // every node lives in `arena`, so the DOM is never destroyed node by node:
+    // the arena releases it in one shot when this function returns
+    alignas(ArenaJson) unsigned char storage[sizeof(ArenaJson)];
+    const ArenaJson* json_data = nullptr;
+    PhaseTimer parse_timer(stats ? &stats->parse : nullptr);
+    JFETCH_PROBE1(parse__start, body.size());
+    json_data = ::new (storage) ArenaJson(parse_body<ArenaJson>(body, format, target.select));
+    JFETCH_PROBE1(parse__done, body.size());
+    parse_timer.stop();
+
+    PhaseTimer decode_timer(stats ? &stats->decode : nullptr);
+    return target.arena_decoder(*json_data);
+  }
+
+  /**
+   * @brief Parses text JSON, CBOR or MessagePack into a DOM, reporting syntax errors as `JFetchParsingException`.
+   * @param select If not empty, only these parts of the document are built.
+   */
+  template <typename Json, typename Body>
+  static Json parse_body(const Body& body, WireFormat format, const JsonSelection& select = {}) {
+    try {
+      if (select.empty()) {
+        if (format == WireFormat::Json) {
+          return Json::parse(body.begin(), body.end());
+        }
+        if constexpr (std::is_same_v<Json, nlohmann::json>) {
+          return format == WireFormat::Cbor ? Json::from_cbor(body.begin(), body.end())
+                                            : Json::from_msgpack(body.begin(), body.end());
+        }
+      }
+
+      Json result;
+      JsonDomBuilder<Json> builder(result);
+      if constexpr (std::is_same_v<Json, nlohmann::json>) {
+        PrunedSax<Json> pruned(builder, select);
+        Json::sax_parse(body.begin(), body.end(), &pruned, input_format(format));
+      } else if (select.empty()) {
+        // only arena DOMs from binary formats get here
+        ArenaBinarySax<> bridge(builder);
+        nlohmann::json::sax_parse(body.begin(), body.end(), &bridge, input_format(format));
+      } else {
+        // ArenaJson::sax_parse would also instantiate the binary readers, which arena DOMs
+        // cannot use, so every format is read as nlohmann::json; pruning sees those events
+        // first, and only what it forwards is copied into the arena
+        ArenaBinarySax<> bridge(builder);
+        PrunedSax<nlohmann::json, ArenaBinarySax<>> pruned(bridge, select);
+        nlohmann::json::sax_parse(body.begin(), body.end(), &pruned, input_format(format));
+      }
+      return result;
+    } catch (const nlohmann::json::parse_error& e) {
+      throw JFetchParsingException(e.what());
+    }
+  }
+
+  static nlohmann::json::input_format_t input_format(WireFormat format) {
+    switch (format) {
+      case WireFormat::Cbor:
+        return nlohmann::json::input_format_t::cbor;
+      case WireFormat::MsgPack:
+        return nlohmann::json::input_format_t::msgpack;
+      default:
+        return nlohmann::json::input_format_t::json;
+    }
+  }
+
+  /**
+   * @brief User-defined mapping of endpoints to their HTTP method and parsing logic.
+   */
+  std::unordered_map<std::string, Endpoint<T>> endpoint_lookup;
+  /**
+   * @brief List of global HTTP headers applied to all requests.
+   */
+  std::vector<std::string> global_headers;
+  /**
+   * @brief Receives the `FetchStats` of every fetch (may be `nullptr`).
+   */
+  std::shared_ptr<MetricsSink> metrics_sink;
+  /**
+   * @brief Carries out requests for `fetch()`/`try_fetch()`; libcurl when `nullptr`.
+   */
+  std::shared_ptr<Transport> transport;
+  /**
+   * @brief Tracing policy instance whose hooks are invoked around each fetch.
+   */
+  Tracer tracer;
+
+private:
+  /**
+   * @brief Immutable configuration read by fetches once the fetcher is frozen.
+   */
+  struct Snapshot {
+    std::unordered_map<std::string, Endpoint<T>> endpoints;
+    std::vector<std::string> headers;
+    std::shared_ptr<MetricsSink> sink;
+    std::shared_ptr<Transport> transport;
+  };
+
+  /**
+   * @brief State of one `fetch_async()`, shared by the reactor callback and the decode task.
+   */
+  struct AsyncFetch {
+    AsyncFetch(JFetch& owner, const std::string& url, const Endpoint<T>& target,
+               const std::vector<std::string>& headers, RequestBody body)
+      : owner(owner), client(url, target.method, headers, std::move(body)), target(target) {
+      client.set_accept_compressed(target.accept_compressed);
+      if (target.format != WireFormat::Json) {
+        client.add_header(accept_header(target.format));
+      }
+      client.compress_body(target.request_compression, &stats);
+      std::lock_guard<std::mutex> lock(owner.async_mutex_);
+      ++owner.async_pending_;
+    }
+
+    AsyncFetch(const AsyncFetch&) = delete;
+    AsyncFetch& operator=(const AsyncFetch&) = delete;
+
+    // the last reference goes when the decode task (or a dropped completion) is done with it
+    ~AsyncFetch() {
+      std::lock_guard<std::mutex> lock(owner.async_mutex_);
+      if (--owner.async_pending_ == 0) {
+        owner.async_idle_.notify_all();
+      }
+    }
+
+    JFetch& owner;
+    HttpClient client;
+    Endpoint<T> target;
+    ChunkedBuffer response;
+    FetchStats stats;
+    ResponseSink<ChunkedBuffer> output{response, &stats};
+    std::string endpoint;
+    std::shared_ptr<MetricsSink> sink;
+    std::chrono::steady_clock::time_point started;
+    std::promise<T> promise;
+  };
+
+  WorkStealingExecutor& executor() {
+    return executor_ ? *executor_ : WorkStealingExecutor::instance();
+  }
+
+  /// Completes an async fetch whose transfer failed; runs on the calling thread.
+  void fail_async(AsyncFetch& state, const TransferResult& transfer) {
+    FetchError error = FetchError::from_transfer(transfer);
+    complete(state.endpoint, state.target.metrics.get(), state.sink, state.started, transfer.http_status, &error,
+             state.response.size(), state.client.body_bytes(), &state.stats);
+    state.promise.set_exception(error.to_exception_ptr());
+  }
+
+  /**
+   * @brief The current snapshot, kept alive until this goes out of scope; empty before `freeze()`.
+   */
+  class PinnedSnapshot {
+  public:
+    explicit PinnedSnapshot(const std::atomic<const Snapshot*>& current) {
+      // unfrozen fetchers never pin; the snapshot must be reloaded once the guard is published
+      if (current.load(std::memory_order_acquire)) {
+        guard_.emplace();
+        snapshot_ = current.load(std::memory_order_seq_cst);
+      }
+    }
+
+    explicit operator bool() const { return snapshot_ != nullptr; }
+    const Snapshot* operator->() const { return snapshot_; }
+
+  private:
+    std::optional<EpochDomain::Guard> guard_;
+    const Snapshot* snapshot_ = nullptr;
+  };
+
+  PinnedSnapshot load_snapshot() const {
+    return PinnedSnapshot(snapshot_);
+  }
+
+  /// Copies the protected members into a new snapshot and makes it current (writer lock held).
+  /// The previous snapshot is retired and freed once no fetch can still be reading it.
+  void publish() {
+    const Snapshot* previous = snapshot_.exchange(
+      new Snapshot{endpoint_lookup, global_headers, metrics_sink, transport}, std::memory_order_seq_cst);
+    if (previous) {
+      EpochDomain::instance().retire(previous, [](const void* retired) { delete static_cast<const Snapshot*>(retired); });
+    }
+  }
+
+  /// Publishes the updated configuration if the fetcher is frozen (writer lock held).
+  void republish() {
+    if (snapshot_.load(std::memory_order_relaxed)) {
+      publish();
+    }
+  }
+
+  std::atomic<const Snapshot*> snapshot_{nullptr};  ///< Current snapshot, or `nullptr` before `freeze()`
+  std::mutex writer_mutex_;                         ///< Serializes configuration changes
+  std::shared_ptr<WorkStealingExecutor> executor_;  ///< Decode pool for `fetch_async()`; default if `nullptr`
+  std::mutex async_mutex_;                          ///< Guards `async_pending_`
+  std::condition_variable async_idle_;              ///< Signalled when `async_pending_` drops to zero
+  std::size_t async_pending_ = 0;                   ///< `fetch_async()` calls not completed yet
 };
 
 }  // namespace jfetch
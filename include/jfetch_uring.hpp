@@ -0,0 +1,910 @@
+/**
+ * @file jfetch_uring.hpp
+ * @brief Optional Linux transport speaking plain HTTP/1.1 over io_uring.
+ *
+ * Include after (or instead of) `jfetch.hpp` and install it per fetcher:
+ * @code
+ * fetcher.set_transport(std::make_shared<jfetch::UringTransport>());
+ * @endcode
+ * Meant for high-rate calls to sidecars on localhost: connect, send and
+ * receive go through io_uring with registered buffers, and connections are
+ * kept alive across requests; Unix domain sockets (`JFetch::get_unix_socket()`)
+ * are supported as well as TCP. Only `http://` URLs are supported; redirects
+ * are not followed. Streamed request bodies (`BodySource`) are handed to
+ * libcurl. Talks to the kernel directly, so liburing is not needed.
+ */
+
+#ifndef JFETCH_URING_HPP
+#define JFETCH_URING_HPP
+
+#include "jfetch.hpp"
+
+#include <linux/io_uring.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace jfetch {
+
+/**
+ * @brief Minimal io_uring instance: one submission at a time, driven synchronously.
+ *
+ * Every operation is linked to a timeout, so a stalled peer fails the request
+ * with `-ETIMEDOUT` instead of blocking forever.
+ */
+class UringRing {
+public:
+  /**
+   * @brief Creates the ring; throws `JFetchException` if io_uring is unavailable.
+   */
+  explicit UringRing(unsigned entries = 8) {
+    io_uring_params params{};
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      throw JFetchException(std::string("io_uring_setup failed: ") + std::strerror(errno));
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sq_ring_ = map(sq_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ring_ : map(cq_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+
+    auto* sq = static_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    auto* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  UringRing(const UringRing&) = delete;
+  UringRing& operator=(const UringRing&) = delete;
+
+  ~UringRing() {
+    if (sqes_) ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_size_);
+    if (sq_ring_) ::munmap(sq_ring_, sq_size_);
+    ::close(fd_);
+  }
+
+  /**
+   * @brief Registers fixed buffers for `read_fixed()`/`write_fixed()`.
+   */
+  void register_buffers(const iovec* buffers, unsigned count) {
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers, count) < 0) {
+      throw JFetchException(std::string("io_uring buffer registration failed: ") + std::strerror(errno));
+    }
+  }
+
+  int connect(int socket, const sockaddr* address, socklen_t length, std::chrono::milliseconds timeout) {
+    return run(timeout, [&](io_uring_sqe& sqe) {
+      sqe.opcode = IORING_OP_CONNECT;
+      sqe.fd = socket;
+      sqe.addr = reinterpret_cast<std::uint64_t>(address);
+      sqe.off = length;
+    });
+  }
+
+  int write_fixed(int socket, const char* data, std::size_t length, unsigned buffer,
+                  std::chrono::milliseconds timeout) {
+    return run(timeout, [&](io_uring_sqe& sqe) {
+      sqe.opcode = IORING_OP_WRITE_FIXED;
+      sqe.fd = socket;
+      sqe.addr = reinterpret_cast<std::uint64_t>(data);
+      sqe.len = static_cast<unsigned>(length);
+      sqe.buf_index = static_cast<std::uint16_t>(buffer);
+    });
+  }
+
+  int writev(int socket, const iovec* parts, unsigned count, std::chrono::milliseconds timeout) {
+    return run(timeout, [&](io_uring_sqe& sqe) {
+      sqe.opcode = IORING_OP_WRITEV;
+      sqe.fd = socket;
+      sqe.addr = reinterpret_cast<std::uint64_t>(parts);
+      sqe.len = count;
+    });
+  }
+
+  int read_fixed(int socket, char* data, std::size_t length, unsigned buffer,
+                 std::chrono::milliseconds timeout) {
+    return run(timeout, [&](io_uring_sqe& sqe) {
+      sqe.opcode = IORING_OP_READ_FIXED;
+      sqe.fd = socket;
+      sqe.addr = reinterpret_cast<std::uint64_t>(data);
+      sqe.len = static_cast<unsigned>(length);
+      sqe.buf_index = static_cast<std::uint16_t>(buffer);
+    });
+  }
+
+private:
+  int fd_ = -1;
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sq_size_ = 0;
+  std::size_t cq_size_ = 0;
+  std::size_t sqes_size_ = 0;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  static constexpr std::uint64_t operation_tag = 1;
+  static constexpr std::uint64_t timeout_tag = 2;
+
+  void* map(std::size_t size, off_t offset) {
+    void* mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    if (mapped == MAP_FAILED) {
+      throw JFetchException(std::string("io_uring mmap failed: ") + std::strerror(errno));
+    }
+    return mapped;
+  }
+
+  io_uring_sqe& push() {
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & sq_mask_;
+    io_uring_sqe& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+  }
+
+  /**
+   * @brief Submits one operation linked to a timeout and waits for both completions.
+   * @return The operation's result: bytes transferred, 0, or a negated errno.
+   */
+  template <typename Prepare>
+  int run(std::chrono::milliseconds timeout, Prepare prepare) {
+    __kernel_timespec limit{};
+    limit.tv_sec = timeout.count() / 1000;
+    limit.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+    // the kernel only reads the SQEs during io_uring_enter, so they can be filled after being queued
+    io_uring_sqe& operation = push();
+    prepare(operation);
+    operation.flags = IOSQE_IO_LINK;
+    operation.user_data = operation_tag;
+
+    io_uring_sqe& deadline = push();
+    deadline.opcode = IORING_OP_LINK_TIMEOUT;
+    deadline.fd = -1;
+    deadline.addr = reinterpret_cast<std::uint64_t>(&limit);
+    deadline.len = 1;
+    deadline.user_data = timeout_tag;
+
+    int result = -EIO;
+    bool timed_out = false;
+    unsigned submit = 2;
+    for (unsigned seen = 0; seen < 2;) {
+      long entered = ::syscall(__NR_io_uring_enter, fd_, submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (entered < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -errno;
+      }
+      submit -= std::min<unsigned>(submit, static_cast<unsigned>(entered));
+
+      unsigned head = *cq_head_;
+      unsigned ready = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != ready; ++head, ++seen) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        if (cqe.user_data == operation_tag) {
+          result = cqe.res;
+        } else if (cqe.res == -ETIME) {
+          timed_out = true;
+        }
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+    return timed_out && result == -ECANCELED ? -ETIMEDOUT : result;
+  }
+};
+
+/**
+ * @brief Incremental HTTP/1.1 response parser: status line, headers, and a
+ * Content-Length, chunked or read-until-close body.
+ */
+class HttpResponseParser {
+public:
+  enum class Status { NeedMore, Done, Error };
+
+  /**
+   * @brief Prepares for the response to a request; `head_request` responses have no body.
+   * @param decode Decode a `Content-Encoding` body; set when the request sent `ContentDecoder::accepted()`.
+   */
+  void reset(bool head_request = false, bool decode = false) {
+    state_ = State::Head;
+    head_.clear();
+    line_.clear();
+    remaining_ = 0;
+    status_ = 0;
+    format_ = WireFormat::Json;
+    keep_alive_ = true;
+    head_request_ = head_request;
+    decode_ = decode;
+    decoder_.reset();
+  }
+
+  /**
+   * @brief Consumes received bytes, appending body bytes to `body`.
+   */
+  Status feed(const char* data, std::size_t length, ChunkedBuffer& body) {
+    const char* end = data + length;
+    while (data != end && state_ != State::Done) {
+      switch (state_) {
+        case State::Head: {
+          const char* newline = static_cast<const char*>(std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+          const char* stop = newline ? newline + 1 : end;
+          head_.append(data, stop);
+          data = stop;
+          if (head_.size() > max_head) {
+            return Status::Error;
+          }
+          if (newline && (head_.size() >= 4 && head_.compare(head_.size() - 4, 4, "\r\n\r\n") == 0)) {
+            if (!parse_head(body)) {
+              return Status::Error;
+            }
+          }
+          break;
+        }
+        case State::Fixed: {
+          std::size_t take = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, static_cast<std::uint64_t>(end - data)));
+          if (!append_body(data, take, body)) {
+            return Status::Error;
+          }
+          data += take;
+          remaining_ -= take;
+          if (remaining_ == 0) {
+            state_ = State::Done;
+          }
+          break;
+        }
+        case State::ChunkSize: {
+          const char* newline = static_cast<const char*>(std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+          const char* stop = newline ? newline + 1 : end;
+          line_.append(data, stop);
+          data = stop;
+          if (line_.size() > max_line) {
+            return Status::Error;
+          }
+          if (newline) {
+            std::uint64_t size = 0;
+            auto parsed = std::from_chars(line_.data(), line_.data() + line_.size(), size, 16);
+            if (parsed.ptr == line_.data()) {
+              return Status::Error;
+            }
+            line_.clear();
+            remaining_ = size;
+            state_ = size == 0 ? State::Trailer : State::ChunkData;
+          }
+          break;
+        }
+        case State::ChunkData: {
+          std::size_t take = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, static_cast<std::uint64_t>(end - data)));
+          if (!append_body(data, take, body)) {
+            return Status::Error;
+          }
+          data += take;
+          remaining_ -= take;
+          if (remaining_ == 0) {
+            state_ = State::ChunkEnd;
+            remaining_ = 2;
+          }
+          break;
+        }
+        case State::ChunkEnd: {
+          std::size_t take = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, static_cast<std::uint64_t>(end - data)));
+          data += take;
+          remaining_ -= take;
+          if (remaining_ == 0) {
+            state_ = State::ChunkSize;
+          }
+          break;
+        }
+        case State::Trailer: {
+          const char* newline = static_cast<const char*>(std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+          const char* stop = newline ? newline + 1 : end;
+          line_.append(data, stop);
+          data = stop;
+          if (line_.size() > max_line) {
+            return Status::Error;
+          }
+          if (newline) {
+            // an empty line ends the trailer section
+            if (line_ == "\r\n" || line_ == "\n") {
+              state_ = State::Done;
+            }
+            line_.clear();
+          }
+          break;
+        }
+        case State::UntilClose:
+          if (!append_body(data, static_cast<std::size_t>(end - data), body)) {
+            return Status::Error;
+          }
+          data = end;
+          break;
+        case State::Done:
+          break;
+      }
+    }
+    return state_ == State::Done ? Status::Done : Status::NeedMore;
+  }
+
+  /**
+   * @brief Signals that the peer closed the connection.
+   */
+  Status finish() {
+    if (state_ == State::UntilClose) {
+      state_ = State::Done;
+    }
+    return state_ == State::Done ? Status::Done : Status::Error;
+  }
+
+  long status() const { return status_; }
+  WireFormat format() const { return format_; }
+  bool keep_alive() const { return keep_alive_; }
+  bool started() const { return !head_.empty() || state_ != State::Head; }
+
+  /**
+   * @brief Whether the body's `Content-Encoding` is unsupported, corrupt or truncated.
+   */
+  bool decode_failed() const { return decoder_.failed(); }
+
+private:
+  enum class State { Head, Fixed, ChunkSize, ChunkData, ChunkEnd, Trailer, UntilClose, Done };
+
+  static constexpr std::size_t max_head = 64 * 1024;
+  static constexpr std::size_t max_line = 1024;
+
+  State state_ = State::Head;
+  std::string head_;
+  std::string line_;
+  std::uint64_t remaining_ = 0;
+  long status_ = 0;
+  WireFormat format_ = WireFormat::Json;
+  bool keep_alive_ = true;
+  bool head_request_ = false;
+  bool decode_ = false;
+  ContentDecoder decoder_;
+
+  // encoded bodies are decoded as they arrive, like libcurl's write callback does
+  bool append_body(const char* data, std::size_t length, ChunkedBuffer& body) {
+    if (!decoder_.active()) {
+      body.append(data, length);
+      return true;
+    }
+    return decoder_.feed(data, length, [&body](const char* decoded, std::size_t size) { body.append(decoded, size); });
+  }
+
+  static bool header_is(std::string_view line, std::string_view name) {
+    if (line.size() <= name.size() || line[name.size()] != ':') {
+      return false;
+    }
+    for (std::size_t i = 0; i < name.size(); ++i) {
+      if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static std::string_view header_value(std::string_view line, std::size_t name_length) {
+    std::string_view value = line.substr(name_length + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t' || value.back() == '\r')) value.remove_suffix(1);
+    return value;
+  }
+
+  static bool contains_token(std::string_view value, std::string_view token) {
+    std::string lowered(value);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lowered.find(token) != std::string::npos;
+  }
+
+  bool parse_head(ChunkedBuffer& body) {
+    std::string_view head(head_);
+    std::size_t line_end = head.find("\r\n");
+    std::string_view status_line = head.substr(0, line_end);
+    if (status_line.size() < 12 || status_line.compare(0, 7, "HTTP/1.") != 0) {
+      return false;
+    }
+    keep_alive_ = status_line[7] == '1';
+    if (std::from_chars(status_line.data() + 9, status_line.data() + 12, status_).ec != std::errc{}) {
+      return false;
+    }
+
+    // interim 1xx responses are followed by the real one
+    if (status_ >= 100 && status_ < 200) {
+      head_.clear();
+      return true;
+    }
+
+    bool chunked = false;
+    bool has_length = false;
+    std::uint64_t length = 0;
+    std::string_view encoding;
+    for (std::size_t begin = line_end + 2; begin < head.size();) {
+      std::size_t end = head.find("\r\n", begin);
+      std::string_view line = head.substr(begin, end - begin);
+      begin = end + 2;
+      if (header_is(line, "content-length")) {
+        std::string_view value = header_value(line, 14);
+        if (std::from_chars(value.data(), value.data() + value.size(), length).ec != std::errc{}) {
+          return false;
+        }
+        has_length = true;
+      } else if (header_is(line, "content-type")) {
+        format_ = wire_format_of(header_value(line, 12));
+      } else if (header_is(line, "transfer-encoding")) {
+        chunked = contains_token(header_value(line, 17), "chunked");
+      } else if (header_is(line, "content-encoding")) {
+        encoding = header_value(line, 16);
+      } else if (header_is(line, "connection")) {
+        std::string_view value = header_value(line, 10);
+        if (contains_token(value, "close")) keep_alive_ = false;
+        else if (contains_token(value, "keep-alive")) keep_alive_ = true;
+      }
+    }
+
+    if (decode_ && !encoding.empty() && !decoder_.start(encoding)) {
+      return false;
+    }
+
+    if (head_request_ || status_ == 204 || status_ == 304) {
+      state_ = State::Done;
+    } else if (chunked) {
+      state_ = State::ChunkSize;
+    } else if (has_length) {
+      if (length <= HttpClient::max_presize) {
+        body.reserve(body.size() + static_cast<std::size_t>(length));
+      }
+      remaining_ = length;
+      state_ = length == 0 ? State::Done : State::Fixed;
+    } else {
+      keep_alive_ = false;
+      state_ = State::UntilClose;
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief Plain-HTTP/1.1 transport on io_uring with registered buffers and keep-alive.
+ *
+ * Each concurrent request borrows a session: a ring, a pair of registered
+ * send/receive buffers and one kept-alive connection. Sessions are pooled, so
+ * sequential requests reuse the connection and no buffer is allocated per
+ * request. The request head is written into the send buffer and the body is
+ * sent from the caller's memory; `accept_compressed` responses are decoded
+ * with `ContentDecoder`. A request that fails on a reused connection before any response
+ * byte arrives is retried once on a fresh one.
+ */
+class UringTransport : public Transport {
+public:
+  struct Options {
+    std::size_t buffer_size = 64 * 1024;                 ///< Size of each registered buffer
+    std::chrono::milliseconds timeout{10000};            ///< Limit for each connect, send and receive
+  };
+
+  explicit UringTransport(Options options) : options_(options) {
+    release(make_session());  // fail early if io_uring is unavailable
+  }
+  UringTransport() : UringTransport(Options{}) {}
+
+  /**
+   * @brief Whether the running kernel lets this process use io_uring.
+   */
+  static bool supported() {
+    try {
+      UringRing ring(2);
+      return true;
+    } catch (const JFetchException&) {
+      return false;
+    }
+  }
+
+  TransferResult perform(const HttpClient& request, ChunkedBuffer& response, FetchStats* stats) override {
+    // streamed request bodies go through libcurl's read callback
+    if (request.body_source()) {
+      return request.perform(response, stats);
+    }
+
+    TransferResult result;
+    JFETCH_PROBE1(request__start, request.url().c_str());
+
+    Target target;
+    if (!parse_url(request.url(), target)) {
+      result.curl_code = CURLE_UNSUPPORTED_PROTOCOL;
+      return result;
+    }
+    target.unix_socket = request.unix_socket();
+
+    std::unique_ptr<Session> session = acquire();
+    FetchStats local;
+    FetchStats& timing = stats ? *stats : local;
+    result = exchange(*session, target, request, response, timing);
+    release(std::move(session));
+
+    JFETCH_PROBE3(request__done, request.url().c_str(), static_cast<int>(result.curl_code), result.http_status);
+    timing.http_status = result.http_status;
+    return result;
+  }
+
+  /**
+   * @brief Idle sessions, each holding its kept-alive connection (if the peer left it open).
+   */
+  std::size_t idle() const override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+  }
+
+private:
+  struct Target {
+    std::string host;          ///< Host as written in the URL, for the Host header
+    std::string port = "80";
+    std::string path = "/";
+    std::string unix_socket;   ///< Connect here instead of host:port when set
+
+    std::string peer() const { return unix_socket.empty() ? host + ":" + port : "unix:" + unix_socket; }
+  };
+
+  struct Session {
+    explicit Session(std::size_t buffer_size) : buffers(2 * buffer_size) {
+      iovec registered[2] = {{buffers.data(), buffer_size}, {buffers.data() + buffer_size, buffer_size}};
+      ring.register_buffers(registered, 2);
+    }
+    ~Session() { disconnect(); }
+
+    void disconnect() {
+      if (socket >= 0) {
+        ::close(socket);
+        socket = -1;
+      }
+    }
+
+    UringRing ring;
+    std::vector<char> buffers;  ///< [send | receive], registered with the ring
+    int socket = -1;
+    std::string peer;           ///< `Target::peer()` the socket is connected to
+    HttpResponseParser parser;
+    std::string request;        ///< Request head that did not fit in the registered send buffer
+  };
+
+  Options options_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Session>> idle_;
+  std::unordered_map<std::string, std::pair<sockaddr_storage, socklen_t>> addresses_;  ///< Resolved peers
+
+  std::unique_ptr<Session> make_session() { return std::make_unique<Session>(options_.buffer_size); }
+
+  std::unique_ptr<Session> acquire() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!idle_.empty()) {
+        std::unique_ptr<Session> session = std::move(idle_.back());
+        idle_.pop_back();
+        return session;
+      }
+    }
+    return make_session();
+  }
+
+  void release(std::unique_ptr<Session> session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(std::move(session));
+  }
+
+  static bool parse_url(const std::string& url, Target& target) {
+    constexpr std::string_view scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+      return false;
+    }
+    std::size_t authority_end = url.find_first_of("/?#", scheme.size());
+    std::string authority = url.substr(scheme.size(), authority_end - scheme.size());
+    if (authority_end != std::string::npos) {
+      target.path = url.substr(authority_end, url.find('#', authority_end) - authority_end);
+      if (target.path.front() != '/') {
+        target.path.insert(0, 1, '/');
+      }
+    }
+
+    std::size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+      target.port = authority.substr(colon + 1);
+      target.host = authority.substr(0, colon);
+    } else {
+      target.host = authority;
+    }
+    return !target.host.empty();
+  }
+
+  bool resolve(const Target& target, sockaddr_storage& address, socklen_t& length) {
+    if (!target.unix_socket.empty()) {
+      sockaddr_un local{};
+      if (target.unix_socket.size() >= sizeof(local.sun_path)) {
+        return false;
+      }
+      local.sun_family = AF_UNIX;
+      std::memcpy(local.sun_path, target.unix_socket.c_str(), target.unix_socket.size() + 1);
+      std::memcpy(&address, &local, sizeof(local));
+      length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + target.unix_socket.size() + 1);
+      return true;
+    }
+
+    std::string key = target.peer();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto cached = addresses_.find(key);
+      if (cached != addresses_.end()) {
+        address = cached->second.first;
+        length = cached->second.second;
+        return true;
+      }
+    }
+
+    std::string host = target.host;
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+      host = host.substr(1, host.size() - 2);
+    }
+    addrinfo hints{};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (::getaddrinfo(host.c_str(), target.port.c_str(), &hints, &found) != 0 || !found) {
+      return false;
+    }
+    std::memcpy(&address, found->ai_addr, found->ai_addrlen);
+    length = found->ai_addrlen;
+    ::freeaddrinfo(found);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    addresses_[key] = {address, length};
+    return true;
+  }
+
+  CURLcode connect(Session& session, const Target& target, FetchStats& stats) {
+    auto started = std::chrono::steady_clock::now();
+    sockaddr_storage address{};
+    socklen_t length = 0;
+    if (!resolve(target, address, length)) {
+      return CURLE_COULDNT_RESOLVE_HOST;
+    }
+    auto resolved = std::chrono::steady_clock::now();
+    stats.dns = std::chrono::duration_cast<std::chrono::microseconds>(resolved - started);
+
+    session.socket = ::socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (session.socket < 0) {
+      return CURLE_COULDNT_CONNECT;
+    }
+    if (address.ss_family != AF_UNIX) {
+      int one = 1;
+      ::setsockopt(session.socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    int connected = session.ring.connect(session.socket, reinterpret_cast<const sockaddr*>(&address), length,
+                                         options_.timeout);
+    if (connected < 0) {
+      session.disconnect();
+      return connected == -ETIMEDOUT ? CURLE_OPERATION_TIMEDOUT : CURLE_COULDNT_CONNECT;
+    }
+    session.peer = target.peer();
+    stats.connect = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - resolved);
+    return CURLE_OK;
+  }
+
+  // whether the response may be encoded; same rule as `HttpClient::prepare()`, minus libcurl's own codecs
+  static bool decodes(const HttpClient& request) {
+    return request.accepts_compressed() && !ContentDecoder::accepted().empty();
+  }
+
+  // the request line and headers, handed to `put(std::string_view)` piece by piece
+  template <typename Put>
+  static void write_head(const Target& target, const HttpClient& request, Put&& put) {
+    put(request.method_to_string());
+    put(" ");
+    put(target.path);
+    put(" HTTP/1.1\r\nHost: ");
+    put(target.host);
+    if (target.port != "80") {
+      put(":");
+      put(target.port);
+    }
+    put("\r\n");
+    if (decodes(request)) {
+      put("Accept-Encoding: ");
+      put(ContentDecoder::accepted());
+      put("\r\n");
+    }
+    for (const curl_slist* header = request.headers(); header; header = header->next) {
+      std::string_view line(header->data);
+      // same conventions as CURLOPT_HTTPHEADER: "Name:" removes a header, "Name;" sends it empty
+      if (line.empty() || line.back() == ':') {
+        continue;
+      }
+      if (line.back() == ';') {
+        put(line.substr(0, line.size() - 1));
+        put(":\r\n");
+        continue;
+      }
+      put(line);
+      put("\r\n");
+    }
+    if (request.sends_body()) {
+      char digits[24];
+      auto length = std::to_chars(digits, digits + sizeof(digits), request.body().size());
+      put("Content-Length: ");
+      put(std::string_view(digits, static_cast<std::size_t>(length.ptr - digits)));
+      put("\r\n\r\n");
+    } else {
+      put("\r\n");
+    }
+  }
+
+  /**
+   * @brief Writes the head into the registered send buffer; the body is sent from where it is.
+   * @return The head, in the registered buffer or, if it does not fit there, in `session.request`.
+   */
+  std::string_view build_head(Session& session, const Target& target, const HttpClient& request) {
+    char* buffer = session.buffers.data();
+    std::size_t used = 0;
+    bool fits = true;
+    write_head(target, request, [&](std::string_view part) {
+      if (fits && part.size() <= options_.buffer_size - used) {
+        std::memcpy(buffer + used, part.data(), part.size());
+        used += part.size();
+      } else {
+        fits = false;
+      }
+    });
+    if (fits) {
+      return std::string_view(buffer, used);
+    }
+    session.request.clear();
+    write_head(target, request, [&session](std::string_view part) { session.request += part; });
+    return session.request;
+  }
+
+  /**
+   * @brief Sends the request and reads the response, retrying once if a kept-alive connection went stale.
+   */
+  TransferResult exchange(Session& session, const Target& target, const HttpClient& request,
+                          ChunkedBuffer& response, FetchStats& stats) {
+    TransferResult result;
+    std::string_view head = build_head(session, target, request);
+    std::string_view body = request.sends_body() ? request.body() : std::string_view();
+
+    if (session.socket >= 0 && session.peer != target.peer()) {
+      session.disconnect();
+    }
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      bool reused = session.socket >= 0;
+      stats.connection_reused = reused;
+      if (!reused) {
+        result.curl_code = connect(session, target, stats);
+        if (result.curl_code != CURLE_OK) {
+          return result;
+        }
+      }
+
+      auto sent = std::chrono::steady_clock::now();
+      std::size_t body_before = response.size();
+      session.parser.reset(false, decodes(request));
+      CURLcode code = send(session, head, body);
+      if (code == CURLE_OK) {
+        code = receive(session, response, stats, sent);
+      }
+
+      // a server may close an idle keep-alive connection at any time; try again on a new one
+      if (code != CURLE_OK && reused && !session.parser.started() && code != CURLE_OPERATION_TIMEDOUT) {
+        session.disconnect();
+        continue;
+      }
+
+      result.curl_code = code;
+      result.http_status = session.parser.status();
+      result.format = session.parser.format();
+      stats.body_bytes = response.size() - body_before;
+      stats.request_bytes = request.sends_body() ? request.body().size() : 0;
+      if (code != CURLE_OK || !session.parser.keep_alive()) {
+        session.disconnect();
+      }
+      auto finished = std::chrono::steady_clock::now();
+      stats.transfer = std::chrono::duration_cast<std::chrono::microseconds>(finished - sent) - stats.first_byte;
+      return result;
+    }
+    result.curl_code = CURLE_SEND_ERROR;
+    return result;
+  }
+
+  /**
+   * @brief Sends `head` and `body`; a body-less request in the registered buffer goes out as a fixed write.
+   */
+  CURLcode send(Session& session, std::string_view head, std::string_view body) {
+    bool fixed = head.data() == session.buffers.data() && body.empty();
+    iovec parts[2] = {{const_cast<char*>(head.data()), head.size()}, {const_cast<char*>(body.data()), body.size()}};
+    unsigned count = body.empty() ? 1 : 2;
+    for (unsigned first = 0; first < count;) {
+      int sent = fixed
+        ? session.ring.write_fixed(session.socket, static_cast<const char*>(parts[0].iov_base), parts[0].iov_len, 0,
+                                   options_.timeout)
+        : session.ring.writev(session.socket, parts + first, count - first, options_.timeout);
+      if (sent <= 0) {
+        return sent == -ETIMEDOUT ? CURLE_OPERATION_TIMEDOUT : CURLE_SEND_ERROR;
+      }
+      // skip what was written; a short write resumes mid-part
+      for (std::size_t left = static_cast<std::size_t>(sent); left > 0;) {
+        std::size_t take = std::min(left, parts[first].iov_len);
+        parts[first].iov_base = static_cast<char*>(parts[first].iov_base) + take;
+        parts[first].iov_len -= take;
+        left -= take;
+        if (parts[first].iov_len == 0) {
+          ++first;
+        }
+      }
+    }
+    return CURLE_OK;
+  }
+
+  CURLcode receive(Session& session, ChunkedBuffer& response, FetchStats& stats,
+                   std::chrono::steady_clock::time_point sent) {
+    char* buffer = session.buffers.data() + options_.buffer_size;
+    bool first = true;
+    for (;;) {
+      int received = session.ring.read_fixed(session.socket, buffer, options_.buffer_size, 1, options_.timeout);
+      if (received < 0) {
+        return received == -ETIMEDOUT ? CURLE_OPERATION_TIMEDOUT : CURLE_RECV_ERROR;
+      }
+      if (first) {
+        stats.first_byte = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent);
+        first = false;
+      }
+      if (received == 0) {
+        if (!session.parser.started()) {
+          return CURLE_GOT_NOTHING;
+        }
+        if (session.parser.finish() != HttpResponseParser::Status::Done) {
+          return CURLE_PARTIAL_FILE;
+        }
+        return session.parser.decode_failed() ? CURLE_BAD_CONTENT_ENCODING : CURLE_OK;
+      }
+
+      JFETCH_PROBE1(write__chunk, static_cast<std::size_t>(received));
+      switch (session.parser.feed(buffer, static_cast<std::size_t>(received), response)) {
+        case HttpResponseParser::Status::Done:
+          return session.parser.decode_failed() ? CURLE_BAD_CONTENT_ENCODING : CURLE_OK;
+        case HttpResponseParser::Status::Error:
+          return session.parser.decode_failed() ? CURLE_BAD_CONTENT_ENCODING : CURLE_WEIRD_SERVER_REPLY;
+        case HttpResponseParser::Status::NeedMore:
+          break;
+      }
+    }
+  }
+};
+
+}  // namespace jfetch
+
+#endif  // JFETCH_URING_HPP
@@ -0,0 +1,212 @@
+/**
+ * @file mock_upstream.hpp
+ * @brief Deterministic, fault- and latency-injecting HTTP/1.1 upstream for tests and benchmarks.
+ * @copyright Copyright 2025 vs-123
+ * @license Apache License, Version 2.0
+ */
+
+#ifndef JFETCH_MOCK_UPSTREAM_HPP
+#define JFETCH_MOCK_UPSTREAM_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jfetch_mock {
+
+/**
+ * @brief Distribution of the delay applied before a response's status line.
+ */
+class Latency {
+public:
+  /**
+   * @brief No delay.
+   */
+  Latency() = default;
+
+  /**
+   * @brief Always `delay`.
+   */
+  static Latency fixed(std::chrono::microseconds delay);
+
+  /**
+   * @brief Uniform in `[low, high]`.
+   */
+  static Latency uniform(std::chrono::microseconds low, std::chrono::microseconds high);
+
+  /**
+   * @brief Log-normal with the given median and shape; a realistic long tail.
+   */
+  static Latency lognormal(std::chrono::microseconds median, double sigma);
+
+  /**
+   * @brief `fast` most of the time, `slow` with probability `slow_fraction`.
+   */
+  static Latency bimodal(std::chrono::microseconds fast, std::chrono::microseconds slow, double slow_fraction);
+
+  /**
+   * @brief Draws one delay.
+   */
+  std::chrono::microseconds sample(std::mt19937_64& rng) const;
+
+private:
+  enum class Kind { None, Fixed, Uniform, LogNormal, Bimodal };
+
+  Kind kind_ = Kind::None;
+  double a_ = 0;
+  double b_ = 0;
+  double c_ = 0;
+};
+
+/**
+ * @brief Behaviour of one route.
+ *
+ * Every random choice (status, latency, faults) is drawn from a generator seeded
+ * by the server seed, the path and the route's request counter, so a route
+ * replays the same sequence of behaviours on every run.
+ */
+struct RouteSpec {
+  std::string body{};                                     ///< Response body
+  std::string content_type = "application/json";          ///< Content-Type header
+  std::string content_encoding{};                         ///< Content-Encoding header, if any; `body` is sent as is
+  std::vector<std::pair<int, double>> statuses =
+    std::vector<std::pair<int, double>>(1, {200, 1.0});   ///< Status codes with relative weights
+  Latency latency{};                                      ///< Delay before the status line
+  std::chrono::microseconds header_delay{0};              ///< Slow headers: pause after the status line
+  std::size_t bandwidth = 0;                              ///< Body throttle in bytes per second (0 = unlimited)
+  double reset_probability = 0;                           ///< Chance of answering with a TCP reset instead
+  double partial_probability = 0;                         ///< Chance of closing the connection mid-body
+  double partial_fraction = 0.5;                          ///< Portion of the body sent before a partial close
+  std::string location{};                                 ///< Location header, sent with 3xx statuses
+};
+
+/**
+ * @brief Running 64-bit FNV-1a digest, so request bodies can be checked without being kept.
+ */
+class BodyDigest {
+public:
+  void update(const char* data, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i) {
+      hash_ = (hash_ ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    }
+  }
+
+  std::uint64_t value() const { return hash_; }
+
+private:
+  std::uint64_t hash_ = 14695981039346656037ull;
+};
+
+/**
+ * @brief Counters for one route.
+ */
+struct RouteStats {
+  std::uint64_t requests = 0;  ///< Requests received
+  std::uint64_t resets = 0;    ///< Connections reset
+  std::uint64_t partials = 0;  ///< Bodies cut short
+  std::uint64_t body_bytes = 0;   ///< Request body bytes of the last request
+  std::uint64_t body_digest = 0;  ///< `BodyDigest` of the last request body
+  bool body_chunked = false;      ///< Whether the last request body was sent with `Transfer-Encoding: chunked`
+};
+
+/**
+ * @brief Local HTTP/1.1 keep-alive server on 127.0.0.1 (and optionally a Unix
+ * socket), one thread per connection.
+ *
+ * Routes can be added or replaced while the server runs, so a test can change
+ * the upstream's behaviour between phases. Unknown paths answer 404.
+ */
+class MockUpstream {
+public:
+  /**
+   * @brief Binds an ephemeral loopback port.
+   * @param seed Seed for every random choice the server makes.
+   */
+  explicit MockUpstream(std::uint64_t seed = 42);
+
+  MockUpstream(const MockUpstream&) = delete;
+  MockUpstream& operator=(const MockUpstream&) = delete;
+
+  ~MockUpstream();
+
+  /**
+   * @brief Adds or replaces a route; the query string is ignored when matching.
+   */
+  void route(const std::string& path, RouteSpec spec);
+
+  /**
+   * @brief Shorthand for a plain 200 response.
+   */
+  void route(const std::string& path, std::string body, std::string content_type = "application/json");
+
+  /**
+   * @brief Returns the counters of a route.
+   */
+  RouteStats stats(const std::string& path) const;
+
+  /**
+   * @brief Also serves the same routes on a Unix domain socket; call before `start()`.
+   * @param path Socket file to create; an existing file at `path` is replaced.
+   */
+  void listen_unix(const std::string& path);
+
+  /**
+   * @brief Starts accepting connections in the background.
+   */
+  void start();
+
+  /**
+   * @brief Closes every socket and joins all threads.
+   */
+  void stop();
+
+  /**
+   * @brief Returns `http://127.0.0.1:<port>`.
+   */
+  std::string base_url() const;
+
+  /**
+   * @brief Returns the bound TCP port.
+   */
+  unsigned short port() const { return port_; }
+
+  /**
+   * @brief Returns the Unix socket path given to `listen_unix()`, or an empty string.
+   */
+  const std::string& unix_socket() const { return unix_path_; }
+
+private:
+  struct Route;
+
+  std::uint64_t seed_;
+  int listen_fd_ = -1;
+  unsigned short port_ = 0;
+  std::atomic<bool> stopping_{false};
+  std::thread acceptor_;
+  int unix_fd_ = -1;
+  std::string unix_path_;
+  std::thread unix_acceptor_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<Route>> routes_;
+  std::vector<std::thread> workers_;
+  std::vector<std::thread::id> finished_;  ///< Workers done serving, joined on the next accept
+  std::vector<int> client_fds_;
+
+  void accept_loop(int listen_fd);
+  void reap_workers();
+  void serve(int fd);
+  void close_client(int fd, bool reset);
+};
+
+}  // namespace jfetch_mock
+
+#endif  // JFETCH_MOCK_UPSTREAM_HPP
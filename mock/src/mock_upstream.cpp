@@ -0,0 +1,559 @@
+#include "jfetch_mock/mock_upstream.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace jfetch_mock {
+
+Latency Latency::fixed(std::chrono::microseconds delay) {
+  Latency latency;
+  latency.kind_ = Kind::Fixed;
+  latency.a_ = static_cast<double>(delay.count());
+  return latency;
+}
+
+Latency Latency::uniform(std::chrono::microseconds low, std::chrono::microseconds high) {
+  Latency latency;
+  latency.kind_ = Kind::Uniform;
+  latency.a_ = static_cast<double>(low.count());
+  latency.b_ = static_cast<double>(std::max(low, high).count());
+  return latency;
+}
+
+Latency Latency::lognormal(std::chrono::microseconds median, double sigma) {
+  Latency latency;
+  latency.kind_ = Kind::LogNormal;
+  latency.a_ = std::log(static_cast<double>(std::max<std::int64_t>(median.count(), 1)));
+  latency.b_ = sigma;
+  return latency;
+}
+
+Latency Latency::bimodal(std::chrono::microseconds fast, std::chrono::microseconds slow, double slow_fraction) {
+  Latency latency;
+  latency.kind_ = Kind::Bimodal;
+  latency.a_ = static_cast<double>(fast.count());
+  latency.b_ = static_cast<double>(slow.count());
+  latency.c_ = slow_fraction;
+  return latency;
+}
+
+std::chrono::microseconds Latency::sample(std::mt19937_64& rng) const {
+  double micros = 0;
+  switch (kind_) {
+    case Kind::None:
+      break;
+    case Kind::Fixed:
+      micros = a_;
+      break;
+    case Kind::Uniform:
+      micros = std::uniform_real_distribution<double>(a_, b_)(rng);
+      break;
+    case Kind::LogNormal:
+      micros = std::lognormal_distribution<double>(a_, b_)(rng);
+      break;
+    case Kind::Bimodal:
+      micros = std::bernoulli_distribution(c_)(rng) ? b_ : a_;
+      break;
+  }
+  return std::chrono::microseconds(static_cast<std::int64_t>(micros));
+}
+
+struct MockUpstream::Route {
+  RouteSpec spec;
+  std::uint64_t path_hash;
+  std::atomic<std::uint64_t> requests{0};
+  std::atomic<std::uint64_t> resets{0};
+  std::atomic<std::uint64_t> partials{0};
+  std::atomic<std::uint64_t> body_bytes{0};
+  std::atomic<std::uint64_t> body_digest{0};
+  std::atomic<bool> body_chunked{false};
+};
+
+namespace {
+
+const char* reason_phrase(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 307: return "Temporary Redirect";
+    case 308: return "Permanent Redirect";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 408: return "Request Timeout";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default: return "Unknown";
+  }
+}
+
+// returns the trimmed value of a header, if present (names compared case-insensitively)
+std::optional<std::string> header_value(const std::string& head, const char* name) {
+  std::size_t line = head.find("\r\n");
+  std::size_t name_length = std::strlen(name);
+  while (line != std::string::npos && line + 2 < head.size()) {
+    std::size_t start = line + 2;
+    line = head.find("\r\n", start);
+    if (line - start > name_length && head[start + name_length] == ':' &&
+        strncasecmp(head.c_str() + start, name, name_length) == 0) {
+      std::size_t value = head.find_first_not_of(' ', start + name_length + 1);
+      return head.substr(value, line - value);
+    }
+  }
+  return std::nullopt;
+}
+
+// appends whatever `fd` has next to `buffer`; false once the peer is gone
+bool receive(int fd, std::string& buffer) {
+  char chunk[16 * 1024];
+  ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+  if (n <= 0) {
+    return false;
+  }
+  buffer.append(chunk, static_cast<std::size_t>(n));
+  return true;
+}
+
+enum class BodyRead { Complete, Closed, Malformed };
+
+// a Content-Length value: decimal digits only, no sign, no overflow
+std::optional<std::size_t> parse_length(const std::string& value) {
+  std::size_t length = 0;
+  auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), length);
+  if (error != std::errc{} || end == value.data() || end != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  return length;
+}
+
+// consumes `length` body bytes from the front of `buffer`, receiving more as needed
+BodyRead read_fixed(int fd, std::string& buffer, std::size_t length, BodyDigest& digest, std::size_t& received) {
+  while (length > 0) {
+    if (buffer.empty() && !receive(fd, buffer)) {
+      return BodyRead::Closed;
+    }
+    std::size_t count = std::min(length, buffer.size());
+    digest.update(buffer.data(), count);
+    buffer.erase(0, count);
+    length -= count;
+    received += count;
+  }
+  return BodyRead::Complete;
+}
+
+// consumes the next CRLF-terminated line from `buffer` into `line` (without the CRLF)
+BodyRead read_line(int fd, std::string& buffer, std::string& line) {
+  std::size_t end;
+  while ((end = buffer.find("\r\n")) == std::string::npos) {
+    if (buffer.size() > 8 * 1024) {
+      return BodyRead::Malformed;
+    }
+    if (!receive(fd, buffer)) {
+      return BodyRead::Closed;
+    }
+  }
+  line.assign(buffer, 0, end);
+  buffer.erase(0, end + 2);
+  return BodyRead::Complete;
+}
+
+// consumes a chunked body (RFC 9112, section 7.1), skipping chunk extensions and trailers
+BodyRead read_chunked(int fd, std::string& buffer, BodyDigest& digest, std::size_t& received) {
+  std::string line;
+  for (;;) {
+    if (BodyRead read = read_line(fd, buffer, line); read != BodyRead::Complete) {
+      return read;
+    }
+    std::size_t size = 0;
+    auto [end, error] = std::from_chars(line.data(), line.data() + line.size(), size, 16);
+    if (error != std::errc{} || end == line.data() ||
+        (end != line.data() + line.size() && *end != ';' && *end != ' ' && *end != '\t')) {
+      return BodyRead::Malformed;
+    }
+
+    if (size == 0) {
+      // optional trailer fields, then the empty line that ends the body
+      do {
+        if (BodyRead read = read_line(fd, buffer, line); read != BodyRead::Complete) {
+          return read;
+        }
+      } while (!line.empty());
+      return BodyRead::Complete;
+    }
+
+    if (BodyRead read = read_fixed(fd, buffer, size, digest, received); read != BodyRead::Complete) {
+      return read;
+    }
+    if (BodyRead read = read_line(fd, buffer, line); read != BodyRead::Complete || !line.empty()) {
+      return read == BodyRead::Complete ? BodyRead::Malformed : read;
+    }
+  }
+}
+
+bool send_all(int fd, const char* data, std::size_t length) {
+  while (length > 0) {
+    ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    length -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+// sends `length` bytes at no more than `bandwidth` bytes per second (0 = unlimited)
+bool send_throttled(int fd, const char* data, std::size_t length, std::size_t bandwidth) {
+  if (bandwidth == 0) {
+    return send_all(fd, data, length);
+  }
+
+  auto started = std::chrono::steady_clock::now();
+  std::size_t slice = std::max<std::size_t>(bandwidth / 50, 1);
+  std::size_t sent = 0;
+  while (sent < length) {
+    std::size_t count = std::min(slice, length - sent);
+    if (!send_all(fd, data + sent, count)) {
+      return false;
+    }
+    sent += count;
+    std::this_thread::sleep_until(started + std::chrono::microseconds(sent * 1000000 / bandwidth));
+  }
+  return true;
+}
+
+int pick_status(const std::vector<std::pair<int, double>>& statuses, std::mt19937_64& rng) {
+  double total = 0;
+  for (const auto& [status, weight] : statuses) {
+    total += weight;
+  }
+  if (total <= 0) {
+    return 200;
+  }
+
+  double point = std::uniform_real_distribution<double>(0, total)(rng);
+  for (const auto& [status, weight] : statuses) {
+    if (point < weight) {
+      return status;
+    }
+    point -= weight;
+  }
+  return statuses.back().first;
+}
+
+}  // namespace
+
+MockUpstream::MockUpstream(std::uint64_t seed) : seed_(seed) {
+  listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    throw std::runtime_error("socket() failed");
+  }
+  int one = 1;
+  ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      ::listen(listen_fd_, 512) < 0) {
+    ::close(listen_fd_);
+    throw std::runtime_error("bind()/listen() failed");
+  }
+
+  socklen_t length = sizeof(address);
+  ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+  port_ = ntohs(address.sin_port);
+}
+
+MockUpstream::~MockUpstream() {
+  stop();
+}
+
+void MockUpstream::route(const std::string& path, RouteSpec spec) {
+  auto route = std::make_shared<Route>();
+  route->spec = std::move(spec);
+  route->path_hash = std::hash<std::string>{}(path);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  routes_[path] = std::move(route);
+}
+
+void MockUpstream::route(const std::string& path, std::string body, std::string content_type) {
+  RouteSpec spec;
+  spec.body = std::move(body);
+  spec.content_type = std::move(content_type);
+  route(path, std::move(spec));
+}
+
+RouteStats MockUpstream::stats(const std::string& path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RouteStats result;
+  auto route = routes_.find(path);
+  if (route != routes_.end()) {
+    result.requests = route->second->requests.load();
+    result.resets = route->second->resets.load();
+    result.partials = route->second->partials.load();
+    result.body_bytes = route->second->body_bytes.load();
+    result.body_digest = route->second->body_digest.load();
+    result.body_chunked = route->second->body_chunked.load();
+  }
+  return result;
+}
+
+void MockUpstream::listen_unix(const std::string& path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Unix socket path too long");
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  unix_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (unix_fd_ < 0) {
+    throw std::runtime_error("socket() failed");
+  }
+  ::unlink(path.c_str());
+  if (::bind(unix_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      ::listen(unix_fd_, 512) < 0) {
+    ::close(unix_fd_);
+    unix_fd_ = -1;
+    throw std::runtime_error("bind()/listen() failed on " + path);
+  }
+  unix_path_ = path;
+}
+
+void MockUpstream::start() {
+  acceptor_ = std::thread([this] { accept_loop(listen_fd_); });
+  if (unix_fd_ >= 0) {
+    unix_acceptor_ = std::thread([this] { accept_loop(unix_fd_); });
+  }
+}
+
+void MockUpstream::stop() {
+  if (stopping_.exchange(true)) {
+    return;
+  }
+  ::shutdown(listen_fd_, SHUT_RDWR);
+  ::close(listen_fd_);
+  if (acceptor_.joinable()) {
+    acceptor_.join();
+  }
+  if (unix_fd_ >= 0) {
+    ::shutdown(unix_fd_, SHUT_RDWR);
+    ::close(unix_fd_);
+    if (unix_acceptor_.joinable()) {
+      unix_acceptor_.join();
+    }
+    ::unlink(unix_path_.c_str());
+  }
+
+  std::vector<std::thread> workers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int fd : client_fds_) {
+      ::shutdown(fd, SHUT_RDWR);
+    }
+    workers.swap(workers_);
+    finished_.clear();
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+std::string MockUpstream::base_url() const {
+  return "http://127.0.0.1:" + std::to_string(port_);
+}
+
+void MockUpstream::accept_loop(int listen_fd) {
+  while (!stopping_) {
+    int fd = ::accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (stopping_) {
+        return;
+      }
+      continue;
+    }
+    if (listen_fd == listen_fd_) {
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    reap_workers();
+    client_fds_.push_back(fd);
+    workers_.emplace_back([this, fd] {
+      serve(fd);
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_.push_back(std::this_thread::get_id());
+    });
+  }
+}
+
+void MockUpstream::reap_workers() {
+  for (std::thread::id id : finished_) {
+    auto worker = std::find_if(workers_.begin(), workers_.end(),
+                               [id](const std::thread& thread) { return thread.get_id() == id; });
+    if (worker != workers_.end()) {
+      // the thread has already released `mutex_` and is only returning
+      worker->join();
+      *worker = std::move(workers_.back());
+      workers_.pop_back();
+    }
+  }
+  finished_.clear();
+}
+
+void MockUpstream::serve(int fd) {
+  std::string buffer;
+  bool keep_alive = true;
+
+  while (keep_alive && !stopping_) {
+    // read until the end of the request head
+    std::size_t head_end;
+    while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (!receive(fd, buffer)) {
+        close_client(fd, false);
+        return;
+      }
+    }
+
+    std::string head = buffer.substr(0, head_end + 2);
+    std::optional<std::string> content_length = header_value(head, "content-length");
+    std::optional<std::string> transfer_encoding = header_value(head, "transfer-encoding");
+    std::optional<std::string> connection = header_value(head, "connection");
+    bool chunked = transfer_encoding && strcasecmp(transfer_encoding->c_str(), "chunked") == 0;
+    std::optional<std::size_t> body_length = content_length ? parse_length(*content_length) : std::size_t{0};
+    keep_alive = !(connection && strcasecmp(connection->c_str(), "close") == 0);
+    buffer.erase(0, head_end + 4);
+
+    // drain the request body, keeping only its size and digest
+    BodyDigest digest;
+    std::size_t received = 0;
+    BodyRead read = chunked        ? read_chunked(fd, buffer, digest, received)
+                    : body_length ? read_fixed(fd, buffer, *body_length, digest, received)
+                                  : BodyRead::Malformed;
+    if (read == BodyRead::Malformed) {
+      static const std::string bad_request =
+        "HTTP/1.1 400 Bad Request\r\nContent-Type: application/json\r\nContent-Length: 23\r\n"
+        "Connection: close\r\n\r\n" R"({"error":"bad request"})";
+      send_all(fd, bad_request.data(), bad_request.size());
+    }
+    if (read != BodyRead::Complete) {
+      close_client(fd, false);
+      return;
+    }
+
+    std::size_t path_start = head.find(' ') + 1;
+    std::string path = head.substr(path_start, head.find(' ', path_start) - path_start);
+    path = path.substr(0, path.find('?'));
+
+    std::shared_ptr<Route> route;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = routes_.find(path);
+      if (found != routes_.end()) {
+        route = found->second;
+      }
+    }
+
+    if (!route) {
+      static const std::string not_found =
+        "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\nContent-Length: 21\r\n\r\n"
+        R"({"error":"not found"})";
+      if (!send_all(fd, not_found.data(), not_found.size())) {
+        break;
+      }
+      continue;
+    }
+
+    const RouteSpec& spec = route->spec;
+    route->body_bytes.store(received);
+    route->body_digest.store(digest.value());
+    route->body_chunked.store(chunked);
+    std::uint64_t index = route->requests.fetch_add(1);
+    std::seed_seq sequence{static_cast<std::uint32_t>(seed_), static_cast<std::uint32_t>(seed_ >> 32),
+                           static_cast<std::uint32_t>(route->path_hash), static_cast<std::uint32_t>(index),
+                           static_cast<std::uint32_t>(index >> 32)};
+    std::mt19937_64 rng(sequence);
+
+    int status = pick_status(spec.statuses, rng);
+    std::chrono::microseconds delay = spec.latency.sample(rng);
+    bool reset = std::bernoulli_distribution(spec.reset_probability)(rng);
+    bool partial = std::bernoulli_distribution(spec.partial_probability)(rng);
+
+    if (delay.count() > 0) {
+      std::this_thread::sleep_for(delay);
+    }
+    if (reset) {
+      route->resets.fetch_add(1);
+      close_client(fd, true);
+      return;
+    }
+
+    std::string error_body = R"({"error":)" + std::to_string(status) + "}";
+    const std::string& body = status >= 200 && status < 300 ? spec.body : error_body;
+
+    std::string status_line = "HTTP/1.1 " + std::to_string(status) + " " + reason_phrase(status) + "\r\n";
+    std::string headers = "Content-Type: " + spec.content_type +
+                          (spec.content_encoding.empty() || status < 200 || status >= 300
+                             ? "" : "\r\nContent-Encoding: " + spec.content_encoding) +
+                          (spec.location.empty() || status < 300 || status >= 400 ? "" : "\r\nLocation: " + spec.location) +
+                          "\r\nContent-Length: " + std::to_string(body.size()) +
+                          (keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+    if (!send_all(fd, status_line.data(), status_line.size())) {
+      break;
+    }
+    if (spec.header_delay.count() > 0) {
+      std::this_thread::sleep_for(spec.header_delay);
+    }
+    if (!send_all(fd, headers.data(), headers.size())) {
+      break;
+    }
+
+    if (partial) {
+      route->partials.fetch_add(1);
+      auto cut = static_cast<std::size_t>(static_cast<double>(body.size()) * std::clamp(spec.partial_fraction, 0.0, 1.0));
+      send_throttled(fd, body.data(), std::min(cut, body.size() ? body.size() - 1 : 0), spec.bandwidth);
+      close_client(fd, false);
+      return;
+    }
+
+    if (!send_throttled(fd, body.data(), body.size(), spec.bandwidth)) {
+      break;
+    }
+  }
+  close_client(fd, false);
+}
+
+void MockUpstream::close_client(int fd, bool reset) {
+  if (reset) {
+    // a zero linger timeout turns close() into a TCP RST
+    linger option{1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &option, sizeof(option));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  client_fds_.erase(std::remove(client_fds_.begin(), client_fds_.end(), fd), client_fds_.end());
+  ::close(fd);
+}
+
+}  // namespace jfetch_mock
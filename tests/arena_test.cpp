@@ -0,0 +1,82 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+static_assert(jfetch::is_arena_backed<jfetch::ArenaJson>::value);
+static_assert(jfetch::is_arena_backed<jfetch::ArenaString>::value);
+static_assert(jfetch::is_arena_backed<std::vector<jfetch::ArenaJson>>::value);
+static_assert(jfetch::is_arena_backed<std::optional<jfetch::ArenaString>>::value);
+static_assert(!jfetch::is_arena_backed<nlohmann::json>::value);
+static_assert(!jfetch::is_arena_backed<std::string>::value);
+static_assert(!jfetch::is_arena_backed<std::vector<std::optional<int>>>::value);
+static_assert(!jfetch::is_arena_backed<int>::value);
+
+const char* const document = R"({"name": "lamp", "tags": ["a", "b", "a long tag that is not stored inline"], "n": 3})";
+
+TEST(ArenaAllocatorTest, ArenaMemoryGoesBackToTheArena) {
+  jfetch_test::TrackingResource arena;
+  {
+    jfetch::ArenaScope scope(&arena);
+    jfetch::ArenaJson json = jfetch::ArenaJson::parse(document);
+    EXPECT_EQ(json["tags"][2], "a long tag that is not stored inline");
+    EXPECT_GT(arena.live(), 0u);
+  }
+  EXPECT_EQ(arena.live(), 0u);
+  EXPECT_EQ(arena.foreign_frees(), 0u);
+}
+
+TEST(ArenaAllocatorTest, ArenaMemoryFreedAfterTheScopeStillGoesToTheArena) {
+  jfetch_test::TrackingResource arena;
+  std::optional<jfetch::ArenaJson> json;
+  {
+    jfetch::ArenaScope scope(&arena);
+    json = jfetch::ArenaJson::parse(document);
+  }
+  EXPECT_GT(arena.live(), 0u);
+  json.reset();
+  EXPECT_EQ(arena.live(), 0u);
+  EXPECT_EQ(arena.foreign_frees(), 0u);
+}
+
+TEST(ArenaAllocatorTest, HeapMemoryFreedInsideAScopeGoesBackToTheHeap) {
+  jfetch_test::TrackingResource arena;
+  std::optional<jfetch::ArenaJson> json = jfetch::ArenaJson::parse(document);
+  jfetch::ArenaString text(200, 'x');
+  {
+    jfetch::ArenaScope scope(&arena);
+    json.reset();
+    text = jfetch::ArenaString(300, 'y');
+    EXPECT_EQ(arena.live(), 1u);
+  }
+  text.clear();
+  text.shrink_to_fit();
+  EXPECT_EQ(arena.live(), 0u);
+  EXPECT_EQ(arena.foreign_frees(), 0u);
+}
+
+TEST(ArenaAllocatorTest, NestedScopesFreeIntoTheirOwnArena) {
+  jfetch_test::TrackingResource outer;
+  jfetch_test::TrackingResource inner;
+  jfetch::ArenaScope outer_scope(&outer);
+  jfetch::ArenaString from_outer(100, 'o');
+  {
+    jfetch::ArenaScope inner_scope(&inner);
+    jfetch::ArenaString from_inner(100, 'i');
+    from_outer.clear();
+    from_outer.shrink_to_fit();
+    EXPECT_EQ(outer.live(), 0u);
+    EXPECT_EQ(inner.live(), 1u);
+  }
+  EXPECT_EQ(inner.live(), 0u);
+  EXPECT_EQ(outer.foreign_frees() + inner.foreign_frees(), 0u);
+}
+
+}  // namespace
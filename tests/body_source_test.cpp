@@ -0,0 +1,249 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+std::uint64_t digest_of(std::string_view bytes) {
+  jfetch_mock::BodyDigest digest;
+  digest.update(bytes.data(), bytes.size());
+  return digest.value();
+}
+
+// deterministic binary payload, NUL bytes included
+std::string payload(std::size_t bytes) {
+  std::string out(bytes, '\0');
+  std::uint64_t state = 88172645463325252ull;
+  for (char& byte : out) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    byte = static_cast<char>(state);
+  }
+  return out;
+}
+
+// resident set size of this process, in bytes
+std::size_t resident_bytes() {
+  long pages = 0, resident = 0;
+  if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    std::fclose(statm);
+  }
+  return static_cast<std::size_t>(resident) * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+class TempFile {
+public:
+  explicit TempFile(const std::string& content) {
+    char name[] = "/tmp/jfetch-body-XXXXXX";
+    int fd = ::mkstemp(name);
+    if (fd < 0) {
+      throw std::runtime_error("mkstemp() failed");
+    }
+    path_ = name;
+    for (std::size_t written = 0; written < content.size();) {
+      ssize_t n = ::write(fd, content.data() + written, content.size() - written);
+      if (n <= 0) {
+        ::close(fd);
+        throw std::runtime_error("write() failed");
+      }
+      written += static_cast<std::size_t>(n);
+    }
+    ::close(fd);
+  }
+
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+
+  ~TempFile() { ::unlink(path_.c_str()); }
+
+  const std::string& path() const { return path_; }
+
+private:
+  std::string path_;
+};
+
+class BodySourceTest : public jfetch_test::MockFetchTest<int> {
+protected:
+  BodySourceTest() {
+    upstream_.route("/upload", R"({"ok": 1})");
+    jfetch_mock::RouteSpec redirect;
+    redirect.statuses = {{307, 1}};
+    redirect.location = "/upload";
+    upstream_.route("/redirect", redirect);
+    for (const char* path : {"/upload", "/redirect"}) {
+      fetcher_.set_endpoint(path, {jfetch::RequestMethod::POST, [](const nlohmann::json& json_data) {
+        return json_data["ok"].get<int>();
+      }});
+    }
+  }
+
+  // checks that the last body `path` received is exactly `expected`
+  void expect_received(const std::string& path, std::string_view expected, bool chunked) {
+    jfetch_mock::RouteStats stats = upstream_.stats(path);
+    EXPECT_EQ(stats.body_bytes, expected.size());
+    EXPECT_EQ(stats.body_digest, digest_of(expected));
+    EXPECT_EQ(stats.body_chunked, chunked);
+  }
+};
+
+TEST_F(BodySourceTest, GeneratorOfUnknownSizeIsSentChunked) {
+  std::string body = payload((3 << 20) + 123);
+  std::size_t offset = 0;
+  auto source = std::make_shared<jfetch::GeneratorBodySource>([&](char* buffer, std::size_t capacity) {
+    // odd piece sizes, so chunk boundaries never line up with libcurl's buffer
+    std::size_t count = std::min({capacity, std::size_t{7001}, body.size() - offset});
+    std::memcpy(buffer, body.data() + offset, count);
+    offset += count;
+    return count;
+  });
+
+  EXPECT_EQ(fetcher_.fetch("/upload", {}, {}, source), 1);
+  expect_received("/upload", body, true);
+  EXPECT_EQ(source->consumed(), body.size());
+}
+
+TEST_F(BodySourceTest, EmptyGeneratorSendsEmptyChunkedBody) {
+  auto source = std::make_shared<jfetch::GeneratorBodySource>([](char*, std::size_t) { return std::size_t{0}; });
+
+  EXPECT_EQ(fetcher_.fetch("/upload", {}, {}, source), 1);
+  expect_received("/upload", "", true);
+}
+
+TEST_F(BodySourceTest, FileIsSentWithContentLength) {
+  std::string body = payload((5 << 20) + 7);
+  TempFile file(body);
+  auto source = std::make_shared<jfetch::FileBodySource>(file.path());
+  ASSERT_EQ(source->size(), body.size());
+
+  EXPECT_EQ(fetcher_.fetch("/upload", {}, {}, source), 1);
+  expect_received("/upload", body, false);
+}
+
+TEST_F(BodySourceTest, DescriptorIsSentFromItsCurrentOffset) {
+  std::string body = payload(100000);
+  TempFile file(body);
+  int fd = ::open(file.path().c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(::lseek(fd, 1000, SEEK_SET), 1000);
+
+  EXPECT_EQ(fetcher_.fetch("/upload", {}, {}, std::make_shared<jfetch::FileBodySource>(fd, true)), 1);
+  expect_received("/upload", std::string_view(body).substr(1000), false);
+}
+
+TEST_F(BodySourceTest, MappedFileIsSentAndReleasedBehindTheUpload) {
+  std::uint64_t expected = 0;
+  std::unique_ptr<TempFile> file;
+  {
+    // the in-memory copy is gone before resident memory is measured
+    std::string body = payload(48 << 20);
+    expected = digest_of(body);
+    file = std::make_unique<TempFile>(body);
+  }
+
+  auto source = std::make_shared<jfetch::MappedBodySource>(file->path());
+  std::size_t before = resident_bytes();
+  EXPECT_EQ(fetcher_.fetch("/upload", {}, {}, source), 1);
+
+  // without MADV_DONTNEED every page of the 48 MiB mapping would still be resident here
+  std::size_t after = resident_bytes();
+  EXPECT_LT(after, before + (16 << 20));
+
+  jfetch_mock::RouteStats stats = upstream_.stats("/upload");
+  EXPECT_EQ(stats.body_bytes, std::size_t{48} << 20);
+  EXPECT_EQ(stats.body_digest, expected);
+  EXPECT_FALSE(stats.body_chunked);
+}
+
+TEST_F(BodySourceTest, RedirectReplaysRewindableSource) {
+  std::string body = payload(2 << 20);
+  TempFile file(body);
+
+  EXPECT_EQ(fetcher_.fetch("/redirect", {}, {}, std::make_shared<jfetch::FileBodySource>(file.path())), 1);
+  expect_received("/redirect", body, false);
+  expect_received("/upload", body, false);
+}
+
+TEST_F(BodySourceTest, RedirectFailsForOneShotGenerator) {
+  std::string body = payload(2 << 20);
+  std::size_t offset = 0;
+  auto source = std::make_shared<jfetch::GeneratorBodySource>([&](char* buffer, std::size_t capacity) {
+    std::size_t count = std::min(capacity, body.size() - offset);
+    std::memcpy(buffer, body.data() + offset, count);
+    offset += count;
+    return count;
+  });
+
+  jfetch::Expected<int> result = fetcher_.try_fetch("/redirect", {}, {}, source);
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Transport);
+  EXPECT_EQ(result.error().curl_code(), CURLE_SEND_FAIL_REWIND);
+  EXPECT_EQ(upstream_.stats("/upload").requests, 0u);
+}
+
+TEST_F(BodySourceTest, FailedRewindDoesNotBreakLaterUploads) {
+  bool sent = false;
+  auto one_shot = std::make_shared<jfetch::GeneratorBodySource>([&](char* buffer, std::size_t capacity) {
+    std::size_t count = sent ? 0 : std::min(capacity, std::size_t{100});
+    std::memset(buffer, 'y', count);
+    sent = true;
+    return count;
+  });
+  jfetch::Expected<int> failed = fetcher_.try_fetch("/redirect", {}, {}, one_shot);
+  ASSERT_FALSE(failed);
+  ASSERT_EQ(failed.error().curl_code(), CURLE_SEND_FAIL_REWIND);
+
+  // the next upload on this thread must not inherit the pending rewind
+  std::string body = payload(20000);
+  std::size_t offset = 0;
+  auto source = std::make_shared<jfetch::GeneratorBodySource>([&](char* buffer, std::size_t capacity) {
+    std::size_t count = std::min(capacity, body.size() - offset);
+    std::memcpy(buffer, body.data() + offset, count);
+    offset += count;
+    return count;
+  });
+  EXPECT_EQ(fetcher_.fetch("/upload", {}, {}, source), 1);
+  expect_received("/upload", body, true);
+}
+
+TEST_F(BodySourceTest, ThrowingGeneratorAbortsTheUpload) {
+  std::size_t calls = 0;
+  auto source = std::make_shared<jfetch::GeneratorBodySource>([&](char* buffer, std::size_t capacity) -> std::size_t {
+    if (++calls == 3) {
+      throw std::runtime_error("export failed");
+    }
+    std::memset(buffer, 'x', capacity);
+    return capacity;
+  });
+
+  jfetch::Expected<int> result = fetcher_.try_fetch("/upload", {}, {}, source);
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Transport);
+  EXPECT_EQ(result.error().curl_code(), CURLE_ABORTED_BY_CALLBACK);
+  EXPECT_EQ(upstream_.stats("/upload").requests, 0u);
+}
+
+TEST_F(BodySourceTest, MalformedChunkFramingIsRejected) {
+  std::string response = jfetch_test::raw_exchange(upstream_.port(),
+    "POST /upload HTTP/1.1\r\nHost: mock\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\nhello\r\n0\r\n\r\n");
+  EXPECT_EQ(response.compare(0, 12, "HTTP/1.1 400"), 0) << response;
+  EXPECT_EQ(upstream_.stats("/upload").requests, 0u);
+}
+
+}  // namespace
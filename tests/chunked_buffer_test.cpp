@@ -0,0 +1,98 @@
+#include "../include/jfetch.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+
+// array allocations are counted so the bytes the allocator keeps can be measured; chunks are `new char[]`
+namespace {
+std::atomic<long long> live_array_bytes{0};
+}
+
+void* operator new[](std::size_t size) {
+  if (void* p = std::malloc(size ? size : 1)) {
+    live_array_bytes += static_cast<long long>(malloc_usable_size(p));
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete[](void* p) noexcept {
+  if (p) {
+    live_array_bytes -= static_cast<long long>(malloc_usable_size(p));
+    std::free(p);
+  }
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  operator delete[](p);
+}
+
+namespace {
+
+using jfetch::SlabAllocator;
+
+// the most a quiet allocator may keep: this thread's cache plus the shared list
+constexpr long long retained_limit =
+  static_cast<long long>((SlabAllocator::thread_cache_chunks + SlabAllocator::max_free_chunks) * (SlabAllocator::chunk_size + 64));
+
+void fill(jfetch::ChunkedBuffer& buffer, std::size_t bytes) {
+  std::string block(4000, 'x');
+  while (buffer.size() < bytes) {
+    buffer.append(block.data(), std::min(block.size(), bytes - buffer.size()));
+  }
+}
+
+TEST(ChunkedBufferTest, ParsesAcrossChunkBoundaries) {
+  nlohmann::json document = nlohmann::json::array();
+  for (int i = 0; i < 5000; ++i) {
+    document.push_back({{"id", i}, {"name", "item " + std::to_string(i)}});
+  }
+  std::string text = document.dump();
+  ASSERT_GT(text.size(), 4 * SlabAllocator::chunk_size);
+
+  jfetch::ChunkedBuffer buffer;
+  buffer.reserve(text.size());
+  for (std::size_t offset = 0; offset < text.size(); offset += 1000) {
+    buffer.append(text.data() + offset, std::min<std::size_t>(1000, text.size() - offset));
+  }
+  EXPECT_EQ(buffer.size(), text.size());
+  EXPECT_EQ(buffer.to_string(), text);
+  EXPECT_EQ(nlohmann::json::parse(buffer.begin(), buffer.end()), document);
+}
+
+TEST(ChunkedBufferTest, LargeBodiesDoNotPinTheirPeak) {
+  long long before = live_array_bytes.load();
+  {
+    jfetch::ChunkedBuffer buffer;
+    fill(buffer, 64 << 20);
+    EXPECT_GE(live_array_bytes.load() - before, (64 << 20) - retained_limit);
+  }
+  EXPECT_LE(live_array_bytes.load() - before, retained_limit);
+
+  // a second large body reuses what was kept and returns the rest again
+  {
+    jfetch::ChunkedBuffer buffer;
+    fill(buffer, 32 << 20);
+  }
+  EXPECT_LE(live_array_bytes.load() - before, retained_limit);
+}
+
+TEST(ChunkedBufferTest, ChunksMayBeReleasedOnAnotherThread) {
+  long long before = live_array_bytes.load();
+  for (int round = 0; round < 8; ++round) {
+    jfetch::ChunkedBuffer buffer;
+    std::thread([&buffer] { fill(buffer, 8 << 20); }).join();
+    EXPECT_EQ(buffer.size(), std::size_t{8} << 20);
+  }
+  // the filling threads have exited, so only the shared list and this thread's cache remain
+  EXPECT_LE(live_array_bytes.load() - before, retained_limit);
+}
+
+}  // namespace
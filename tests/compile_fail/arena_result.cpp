@@ -0,0 +1,10 @@
+// Must not compile: an arena-backed decoder returns memory from the arena it was decoded in.
+#include "../../include/jfetch.hpp"
+
+int main() {
+  jfetch::Endpoint<jfetch::ArenaString> endpoint{jfetch::RequestMethod::GET,
+                                                jfetch::with_arena([](const jfetch::ArenaJson& json_data) {
+    return json_data["name"].get<jfetch::ArenaString>();
+  })};
+  return endpoint.arena_decoder ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+// Must not compile: two members are mapped to the same JSON key.
+#include "../../include/jfetch.hpp"
+
+struct Product {
+  int id = 0;
+  int legacy_id = 0;
+};
+
+JFETCH_FIELDS(Product, JFETCH_FIELD(id), jfetch::field("id", &Product::legacy_id));
+
+int main() {
+  return jfetch::decode_fields<Product>(nlohmann::json::object()).id;
+}
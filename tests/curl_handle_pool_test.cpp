@@ -0,0 +1,50 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <string>
+
+namespace {
+
+class CurlHandlePoolTest : public jfetch_test::MockFetchTest<int> {
+protected:
+  CurlHandlePoolTest() {
+    upstream_.route("/items", "[1, 2, 3]");
+    fetcher_.set_endpoint("/items", {jfetch::RequestMethod::GET, jfetch_test::count_elements});
+    pool_.clear();
+  }
+
+  ~CurlHandlePoolTest() override { pool_.clear(); }
+
+  jfetch::CurlHandlePool& pool_ = jfetch::CurlHandlePool::instance();
+};
+
+TEST_F(CurlHandlePoolTest, HandlesShareOneConnectionCache) {
+  jfetch::FetchStats stats;
+  ASSERT_TRUE(fetcher_.try_fetch("/items", {}, {}, {}, &stats));
+  EXPECT_FALSE(stats.connection_reused);
+
+  // the handle that opened the connection stays borrowed, so the next fetch gets a fresh one
+  jfetch::CurlHandlePool::Handle held = pool_.acquire();
+  ASSERT_TRUE(held);
+  EXPECT_EQ(pool_.idle(), 0u);
+  ASSERT_TRUE(fetcher_.try_fetch("/items", {}, {}, {}, &stats));
+  EXPECT_TRUE(stats.connection_reused);
+}
+
+TEST_F(CurlHandlePoolTest, ClearClosesIdleHandlesAndTheirConnections) {
+  jfetch::FetchStats stats;
+  ASSERT_TRUE(fetcher_.try_fetch("/items", {}, {}, {}, &stats));
+  EXPECT_EQ(pool_.idle(), 1u);
+
+  pool_.clear();
+  EXPECT_EQ(pool_.idle(), 0u);
+  ASSERT_TRUE(fetcher_.try_fetch("/items", {}, {}, {}, &stats));
+  EXPECT_FALSE(stats.connection_reused);
+  EXPECT_EQ(upstream_.stats("/items").requests, 2u);
+}
+
+}  // namespace
@@ -0,0 +1,62 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+TEST(FetchAsyncTest, DestroyingTheFetcherWaitsForItsFetches) {
+  jfetch_mock::MockUpstream upstream;
+  jfetch_mock::RouteSpec slow;
+  slow.body = "[1, 2, 3]";
+  slow.latency = jfetch_mock::Latency::fixed(50ms);
+  upstream.route("/items", slow);
+  upstream.start();
+
+  std::vector<std::future<int>> futures;
+  {
+    jfetch_test::MockFetcher<int> fetcher(upstream.base_url());
+    fetcher.set_endpoint("/items", {jfetch::RequestMethod::GET, jfetch_test::count_elements});
+    for (int i = 0; i < 8; ++i) {
+      futures.push_back(fetcher.fetch_async("/items"));
+    }
+  }
+  for (std::future<int>& future : futures) {
+    ASSERT_EQ(future.wait_for(0s), std::future_status::ready);
+    EXPECT_EQ(future.get(), 3);
+  }
+}
+
+TEST(WorkStealingExecutorTest, DestructionRunsQueuedTasks) {
+  std::atomic<int> ran{0};
+  std::promise<void> open;
+  std::shared_future<void> gate = open.get_future().share();
+  std::thread opener;
+  {
+    jfetch::WorkStealingExecutor pool(1);
+    pool.submit([gate] { gate.wait(); });
+    for (int i = 0; i < 100; ++i) {
+      pool.submit([&ran] { ++ran; });
+    }
+    // the only worker is still blocked when the pool starts stopping
+    opener = std::thread([&open] {
+      std::this_thread::sleep_for(50ms);
+      open.set_value();
+    });
+  }
+  opener.join();
+  EXPECT_EQ(ran, 100);
+}
+
+}  // namespace
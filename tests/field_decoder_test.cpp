@@ -0,0 +1,207 @@
+#include "../include/jfetch.hpp"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace fields_test {
+
+struct Dimensions {
+  double width = 0;
+  double height = 0;
+};
+
+struct Review {
+  int rating = 0;
+  std::string comment;
+  std::optional<Dimensions> photo;
+};
+
+struct Product {
+  int id = -1;
+  std::string title = "untitled";
+  double price = 0;
+  std::vector<std::string> tags;
+  std::optional<int> stock;
+  std::optional<Dimensions> dimensions;
+  std::vector<Review> reviews;
+  std::optional<std::vector<Review>> featured;
+};
+
+// more keys than fit in the smallest hash table
+struct Wide {
+  int k00 = 0, k01 = 0, k02 = 0, k03 = 0, k04 = 0, k05 = 0, k06 = 0, k07 = 0, k08 = 0, k09 = 0;
+  int k10 = 0, k11 = 0, k12 = 0, k13 = 0, k14 = 0, k15 = 0, k16 = 0, k17 = 0, k18 = 0, k19 = 0;
+};
+
+}  // namespace fields_test
+
+JFETCH_FIELDS(fields_test::Dimensions, JFETCH_FIELD(width), JFETCH_FIELD(height));
+JFETCH_FIELDS(fields_test::Review, JFETCH_FIELD(rating), jfetch::field("text", &fields_test::Review::comment),
+              JFETCH_FIELD(photo));
+JFETCH_FIELDS(fields_test::Product, JFETCH_FIELD(id), JFETCH_FIELD(title), jfetch::field("price_usd", &fields_test::Product::price),
+              JFETCH_FIELD(tags), JFETCH_FIELD(stock), JFETCH_FIELD(dimensions), JFETCH_FIELD(reviews),
+              JFETCH_FIELD(featured));
+JFETCH_FIELDS(fields_test::Wide, JFETCH_FIELD(k00), JFETCH_FIELD(k01), JFETCH_FIELD(k02), JFETCH_FIELD(k03),
+              JFETCH_FIELD(k04), JFETCH_FIELD(k05), JFETCH_FIELD(k06), JFETCH_FIELD(k07), JFETCH_FIELD(k08),
+              JFETCH_FIELD(k09), JFETCH_FIELD(k10), JFETCH_FIELD(k11), JFETCH_FIELD(k12), JFETCH_FIELD(k13),
+              JFETCH_FIELD(k14), JFETCH_FIELD(k15), JFETCH_FIELD(k16), JFETCH_FIELD(k17), JFETCH_FIELD(k18),
+              JFETCH_FIELD(k19));
+
+namespace {
+
+using fields_test::Product;
+
+const char* const full_product = R"({
+  "id": 7,
+  "title": "Lamp",
+  "price_usd": 19.5,
+  "tags": ["home", "light"],
+  "stock": 12,
+  "dimensions": {"width": 10.5, "height": 30},
+  "reviews": [
+    {"rating": 5, "text": "bright", "photo": {"width": 640, "height": 480}},
+    {"rating": 2, "text": "wobbly", "photo": null}
+  ],
+  "featured": [{"rating": 4, "text": "nice"}]
+})";
+
+// parses `text` into an arena DOM and decodes it there, as a `with_arena()` endpoint does
+template <typename T>
+T decode_in_arena(const std::string& text) {
+  std::pmr::monotonic_buffer_resource arena;
+  jfetch::ArenaScope scope(&arena);
+  jfetch::ArenaJson json = jfetch::ArenaJson::parse(text);
+  return jfetch::decode_fields<T>(json);
+}
+
+void expect_full_product(const Product& product) {
+  EXPECT_EQ(product.id, 7);
+  EXPECT_EQ(product.title, "Lamp");
+  EXPECT_EQ(product.price, 19.5);
+  EXPECT_EQ(product.tags, (std::vector<std::string>{"home", "light"}));
+  EXPECT_EQ(product.stock, 12);
+  ASSERT_TRUE(product.dimensions);
+  EXPECT_EQ(product.dimensions->width, 10.5);
+  EXPECT_EQ(product.dimensions->height, 30);
+  ASSERT_EQ(product.reviews.size(), 2u);
+  EXPECT_EQ(product.reviews[0].rating, 5);
+  EXPECT_EQ(product.reviews[0].comment, "bright");
+  ASSERT_TRUE(product.reviews[0].photo);
+  EXPECT_EQ(product.reviews[0].photo->width, 640);
+  EXPECT_EQ(product.reviews[1].comment, "wobbly");
+  EXPECT_FALSE(product.reviews[1].photo);
+  ASSERT_TRUE(product.featured);
+  ASSERT_EQ(product.featured->size(), 1u);
+  EXPECT_EQ((*product.featured)[0].comment, "nice");
+  EXPECT_FALSE((*product.featured)[0].photo);
+}
+
+TEST(FieldDecoderTest, DecodesEveryMappedMember) {
+  expect_full_product(jfetch::decode_fields<Product>(nlohmann::json::parse(full_product)));
+}
+
+TEST(FieldDecoderTest, DecodesArenaDocumentsTheSameWay) {
+  expect_full_product(decode_in_arena<Product>(full_product));
+}
+
+TEST(FieldDecoderTest, MissingKeysKeepTheirDefaults) {
+  Product product = jfetch::decode_fields<Product>(nlohmann::json::parse(R"({"id": 3})"));
+  EXPECT_EQ(product.id, 3);
+  EXPECT_EQ(product.title, "untitled");
+  EXPECT_EQ(product.price, 0);
+  EXPECT_TRUE(product.tags.empty());
+  EXPECT_FALSE(product.stock);
+  EXPECT_FALSE(product.dimensions);
+  EXPECT_TRUE(product.reviews.empty());
+  EXPECT_FALSE(product.featured);
+
+  Product empty = decode_in_arena<Product>("{}");
+  EXPECT_EQ(empty.id, -1);
+  EXPECT_EQ(empty.title, "untitled");
+}
+
+TEST(FieldDecoderTest, MissingKeysLeaveExistingValuesAlone) {
+  Product product;
+  product.title = "kept";
+  product.stock = 5;
+  jfetch::FieldDecoder<Product>::decode(nlohmann::json::parse(R"({"id": 1})"), product);
+  EXPECT_EQ(product.id, 1);
+  EXPECT_EQ(product.title, "kept");
+  EXPECT_EQ(product.stock, 5);
+}
+
+TEST(FieldDecoderTest, UnmappedKeysAreSkipped) {
+  // near misses of mapped keys, plus the member name of a renamed key
+  Product product = jfetch::decode_fields<Product>(nlohmann::json::parse(R"({
+    "Id": 1, "id ": 2, "i": 3, "idx": 4, "price": 5, "comment": "x", "": 6, "extra": {"id": 9},
+    "id": 8
+  })"));
+  EXPECT_EQ(product.id, 8);
+  EXPECT_EQ(product.price, 0);
+  EXPECT_EQ(product.title, "untitled");
+}
+
+TEST(FieldDecoderTest, DuplicateKeysInTheDocumentKeepTheLastValue) {
+  const std::string text = R"({"id": 1, "title": "first", "id": 2, "title": "second"})";
+  Product product = jfetch::decode_fields<Product>(nlohmann::json::parse(text));
+  EXPECT_EQ(product.id, 2);
+  EXPECT_EQ(product.title, "second");
+  EXPECT_EQ(decode_in_arena<Product>(text).id, 2);
+}
+
+TEST(FieldDecoderTest, NullResetsAnOptional) {
+  Product product;
+  product.stock = 5;
+  product.dimensions = fields_test::Dimensions{1, 2};
+  product.featured.emplace();
+  jfetch::FieldDecoder<Product>::decode(
+    nlohmann::json::parse(R"({"stock": null, "dimensions": null, "featured": null})"), product);
+  EXPECT_FALSE(product.stock);
+  EXPECT_FALSE(product.dimensions);
+  EXPECT_FALSE(product.featured);
+}
+
+TEST(FieldDecoderTest, NestedOptionalInsideAVector) {
+  Product product = jfetch::decode_fields<Product>(nlohmann::json::parse(R"({
+    "reviews": [{"photo": {"width": 1}}, {}, {"photo": null}]
+  })"));
+  ASSERT_EQ(product.reviews.size(), 3u);
+  ASSERT_TRUE(product.reviews[0].photo);
+  EXPECT_EQ(product.reviews[0].photo->width, 1);
+  EXPECT_EQ(product.reviews[0].photo->height, 0);
+  EXPECT_FALSE(product.reviews[1].photo);
+  EXPECT_FALSE(product.reviews[2].photo);
+}
+
+TEST(FieldDecoderTest, VectorsAreReplacedNotAppended) {
+  Product product;
+  product.reviews.resize(4);
+  jfetch::FieldDecoder<Product>::decode(nlohmann::json::parse(R"({"reviews": [{"rating": 1}]})"), product);
+  ASSERT_EQ(product.reviews.size(), 1u);
+  EXPECT_EQ(product.reviews[0].rating, 1);
+}
+
+TEST(FieldDecoderTest, FindsEveryKeyOfALargeMap) {
+  nlohmann::json json = nlohmann::json::object();
+  for (int i = 0; i < 20; ++i) {
+    json[(i < 10 ? "k0" : "k") + std::to_string(i)] = i + 100;
+  }
+  fields_test::Wide wide = jfetch::decode_fields<fields_test::Wide>(json);
+  EXPECT_EQ(wide.k00, 100);
+  EXPECT_EQ(wide.k09, 109);
+  EXPECT_EQ(wide.k10, 110);
+  EXPECT_EQ(wide.k19, 119);
+}
+
+TEST(FieldDecoderTest, WrongTypesThrow) {
+  EXPECT_THROW(jfetch::decode_fields<Product>(nlohmann::json::parse("[1, 2]")), nlohmann::json::type_error);
+  EXPECT_THROW(jfetch::decode_fields<Product>(nlohmann::json::parse(R"({"id": "seven"})")), nlohmann::json::type_error);
+  EXPECT_THROW(jfetch::decode_fields<Product>(nlohmann::json::parse(R"({"title": 7})")), nlohmann::json::type_error);
+  EXPECT_THROW(jfetch::decode_fields<Product>(nlohmann::json::parse(R"({"reviews": {}})")), nlohmann::json::type_error);
+  EXPECT_THROW(decode_in_arena<Product>(R"({"dimensions": [1]})"), nlohmann::json::type_error);
+}
+
+}  // namespace
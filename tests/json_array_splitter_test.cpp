@@ -0,0 +1,265 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+
+// escaped quotes and backslashes, brackets and commas inside strings, nesting and scalars
+const std::string tricky = R"([ "a\"]", "b\\", {"k": "\\\"", "l": [1, [2, {}]]}, [",", "]"], 3.5e2, null, true, "\\\\\""])";
+
+// the elements of `text`, cut into pieces at `cuts`
+std::vector<std::string> split(const std::string& text, const std::vector<std::size_t>& cuts = {}) {
+  std::vector<std::string> elements;
+  jfetch::JsonArraySplitter splitter([&](std::string_view element) {
+    elements.emplace_back(element);
+    return true;
+  });
+  std::size_t from = 0;
+  for (std::size_t cut : cuts) {
+    splitter.append(text.data() + from, cut - from);
+    from = cut;
+  }
+  splitter.append(text.data() + from, text.size() - from);
+  splitter.finish();
+  return elements;
+}
+
+// re-parses each element and compares it with the matching element of `text`
+void expect_elements(const std::vector<std::string>& elements, const std::string& text) {
+  nlohmann::json expected = nlohmann::json::parse(text);
+  ASSERT_EQ(elements.size(), expected.size());
+  for (std::size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ(nlohmann::json::parse(elements[i]), expected[i]) << "element " << i;
+  }
+}
+
+std::string error_of(const std::string& text) {
+  try {
+    split(text);
+  } catch (const jfetch::JFetchParsingException& e) {
+    // drop the "Parsing Error: " prefix
+    return std::string(e.what()).substr(15);
+  }
+  return "";
+}
+
+TEST(JsonArraySplitterTest, SplitsInOnePiece) {
+  expect_elements(split(tricky), tricky);
+}
+
+TEST(JsonArraySplitterTest, EveryTwoPieceCutYieldsTheSameElements) {
+  for (std::size_t cut = 0; cut <= tricky.size(); ++cut) {
+    SCOPED_TRACE(cut);
+    expect_elements(split(tricky, {cut}), tricky);
+  }
+}
+
+TEST(JsonArraySplitterTest, EveryThreePieceCutYieldsTheSameElements) {
+  for (std::size_t first = 0; first <= tricky.size(); ++first) {
+    for (std::size_t second = first; second <= tricky.size(); ++second) {
+      SCOPED_TRACE(std::to_string(first) + "," + std::to_string(second));
+      expect_elements(split(tricky, {first, second}), tricky);
+    }
+  }
+}
+
+TEST(JsonArraySplitterTest, ElementsSpanningManyPiecesAreGathered) {
+  std::vector<std::size_t> cuts;
+  for (std::size_t i = 1; i < tricky.size(); ++i) {
+    cuts.push_back(i);
+  }
+  expect_elements(split(tricky, cuts), tricky);
+}
+
+TEST(JsonArraySplitterTest, EscapeAtAPieceBoundaryDoesNotEndTheString) {
+  const std::string text = R"(["x\"", "y\\", "z"])";
+  const std::vector<std::string> expected{R"("x\"")", R"("y\\")", R"("z")"};
+  // between the backslash and the quote it escapes, then between two backslashes
+  EXPECT_EQ(split(text, {text.find(R"(\")") + 1}), expected);
+  EXPECT_EQ(split(text, {text.find(R"(\\)") + 1}), expected);
+}
+
+TEST(JsonArraySplitterTest, EmptyArraysHaveNoElements) {
+  EXPECT_TRUE(split("[]").empty());
+  EXPECT_TRUE(split(" \r\n\t[ \n ]\n ").empty());
+  EXPECT_TRUE(split("[ ]", {1, 2}).empty());
+}
+
+TEST(JsonArraySplitterTest, SurroundingWhitespaceIsAllowed) {
+  expect_elements(split("\n[\n  1 ,\n  {\"a\" : 2}\n]\n"), "[1, {\"a\": 2}]");
+}
+
+TEST(JsonArraySplitterTest, MisplacedCommasAreErrors) {
+  EXPECT_EQ(error_of("[1, 2,]"), "expected an array element at byte 6");
+  EXPECT_EQ(error_of("[1, 2, ]"), "expected an array element at byte 7");
+  EXPECT_EQ(error_of("[,1]"), "expected an array element at byte 1");
+  EXPECT_EQ(error_of("[1,,2]"), "expected an array element at byte 3");
+}
+
+TEST(JsonArraySplitterTest, OtherTopLevelValuesAreErrors) {
+  EXPECT_EQ(error_of(R"({"items": [1]})"), "expected a top-level JSON array at byte 0");
+  EXPECT_EQ(error_of("  42"), "expected a top-level JSON array at byte 2");
+  EXPECT_EQ(error_of(R"("[1]")"), "expected a top-level JSON array at byte 0");
+  EXPECT_EQ(error_of("[1] [2]"), "unexpected data after the top-level array at byte 4");
+}
+
+TEST(JsonArraySplitterTest, TruncatedArraysAreErrors) {
+  EXPECT_EQ(error_of(""), "unexpected end of input after 0 bytes; expected the end of the top-level array");
+  EXPECT_EQ(error_of("["), "unexpected end of input after 1 bytes; expected the end of the top-level array");
+  EXPECT_EQ(error_of("[1, 2"), "unexpected end of input after 5 bytes; expected the end of the top-level array");
+  EXPECT_EQ(error_of(R"([1, "a]")"), "unexpected end of input after 8 bytes; expected the end of the top-level array");
+  EXPECT_EQ(error_of("[[1]"), "unexpected end of input after 4 bytes; expected the end of the top-level array");
+}
+
+TEST(JsonArraySplitterTest, HandlerCanStopEarly) {
+  std::vector<std::string> elements;
+  jfetch::JsonArraySplitter splitter([&](std::string_view element) {
+    elements.emplace_back(element);
+    return elements.size() < 2;
+  });
+  splitter.append("[1, 2, 3", 8);
+  splitter.append(", not even json", 15);
+  EXPECT_EQ(elements, (std::vector<std::string>{"1", "2"}));
+  EXPECT_EQ(splitter.elements(), 2u);
+  EXPECT_TRUE(splitter.stopped());
+  EXPECT_TRUE(splitter.halted());
+  EXPECT_NO_THROW(splitter.finish());
+}
+
+TEST(JsonArraySplitterTest, MalformedArraysIgnoreLaterBytes) {
+  std::size_t calls = 0;
+  jfetch::JsonArraySplitter splitter([&](std::string_view) {
+    ++calls;
+    return true;
+  });
+  splitter.append("[1,,", 4);
+  splitter.append("2, 3]", 5);
+  EXPECT_EQ(calls, 1u);
+  EXPECT_FALSE(splitter.stopped());
+  EXPECT_TRUE(splitter.halted());
+  EXPECT_THROW(splitter.finish(), jfetch::JFetchParsingException);
+}
+
+// an array of `count` strings of about 40 bytes, each holding an escaped quote
+std::string long_array(std::size_t count) {
+  std::string text = "[";
+  for (std::size_t i = 0; i < count; ++i) {
+    text += (i ? ", \"" : "\"") + std::string(32, 'a' + static_cast<char>(i % 26)) + "\\\"" + std::to_string(i) + "\"";
+  }
+  return text + "]";
+}
+
+class FetchEachTest : public jfetch_test::MockFetchTest<nlohmann::json> {
+protected:
+  FetchEachTest() {
+    // the mock sends 5 bytes every 20 ms, so most elements span several reads
+    jfetch_mock::RouteSpec tricky_route;
+    tricky_route.body = tricky;
+    tricky_route.bandwidth = 250;
+    upstream_.route("/tricky", tricky_route);
+
+    jfetch_mock::RouteSpec slow;
+    slow.body = long_array(100);
+    slow.bandwidth = 2000;
+    upstream_.route("/slow", slow);
+
+    upstream_.route("/empty", " [ ] ");
+    upstream_.route("/trailing", "[1, 2, ]");
+    upstream_.route("/object", R"({"items": [1, 2]})");
+    upstream_.route("/truncated", "[1, 2, [3");
+
+    jfetch_mock::RouteSpec cut;
+    cut.body = long_array(20);
+    cut.partial_probability = 1;
+    cut.partial_fraction = 0.5;
+    upstream_.route("/cut", cut);
+
+    for (const char* path : {"/tricky", "/slow", "/empty", "/trailing", "/object", "/truncated", "/cut"}) {
+      fetcher_.set_endpoint(path, {jfetch::RequestMethod::GET, jfetch_test::as_is});
+    }
+  }
+};
+
+TEST_F(FetchEachTest, ThrottledArrayDeliversEveryElement) {
+  std::vector<nlohmann::json> received;
+  EXPECT_EQ(fetcher_.fetch_each("/tricky", [&](nlohmann::json&& value) { received.push_back(std::move(value)); }), 8u);
+  EXPECT_EQ(nlohmann::json(received), nlohmann::json::parse(tricky));
+}
+
+TEST_F(FetchEachTest, EmptyArrayDeliversNothing) {
+  std::size_t calls = 0;
+  EXPECT_EQ(fetcher_.fetch_each("/empty", [&](nlohmann::json&&) { ++calls; }), 0u);
+  EXPECT_EQ(calls, 0u);
+}
+
+TEST_F(FetchEachTest, TrailingCommaIsAParseError) {
+  std::vector<nlohmann::json> received;
+  jfetch::Expected<std::size_t> result =
+    fetcher_.try_fetch_each("/trailing", [&](nlohmann::json&& value) { received.push_back(std::move(value)); });
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Parse);
+  EXPECT_EQ(received, (std::vector<nlohmann::json>{1, 2}));
+  EXPECT_THROW(fetcher_.fetch_each("/trailing", [](nlohmann::json&&) {}), jfetch::JFetchParsingException);
+}
+
+TEST_F(FetchEachTest, NonArrayTopLevelIsAParseError) {
+  std::size_t calls = 0;
+  jfetch::Expected<std::size_t> result = fetcher_.try_fetch_each("/object", [&](nlohmann::json&&) { ++calls; });
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Parse);
+  EXPECT_EQ(calls, 0u);
+}
+
+TEST_F(FetchEachTest, UnterminatedArrayIsAParseError) {
+  std::size_t calls = 0;
+  jfetch::Expected<std::size_t> result = fetcher_.try_fetch_each("/truncated", [&](nlohmann::json&&) { ++calls; });
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Parse);
+  EXPECT_EQ(calls, 2u);
+}
+
+TEST_F(FetchEachTest, ConnectionCutMidArrayIsATransportError) {
+  std::size_t calls = 0;
+  jfetch::Expected<std::size_t> result = fetcher_.try_fetch_each("/cut", [&](nlohmann::json&&) { ++calls; });
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Transport);
+  EXPECT_EQ(result.error().curl_code(), CURLE_PARTIAL_FILE);
+  // the first half of the elements arrived before the cut and stay delivered
+  EXPECT_GE(calls, 8u);
+  EXPECT_LT(calls, 20u);
+}
+
+TEST_F(FetchEachTest, CallbackCanStopTheTransferEarly) {
+  // the whole body would take about two seconds at this route's bandwidth
+  auto started = std::chrono::steady_clock::now();
+  std::vector<nlohmann::json> received;
+  std::size_t delivered = fetcher_.fetch_each("/slow", [&](nlohmann::json&& value) {
+    received.push_back(std::move(value));
+    return received.size() < 3;
+  });
+  auto elapsed = std::chrono::steady_clock::now() - started;
+
+  EXPECT_EQ(delivered, 3u);
+  ASSERT_EQ(received.size(), 3u);
+  EXPECT_EQ(received[2], nlohmann::json::parse(long_array(3))[2]);
+  EXPECT_LT(elapsed, std::chrono::seconds(1));
+}
+
+TEST_F(FetchEachTest, CallbackExceptionsAreRethrown) {
+  std::size_t calls = 0;
+  EXPECT_THROW(fetcher_.fetch_each("/tricky", [&](nlohmann::json&&) {
+    if (++calls == 2) {
+      throw std::runtime_error("sink full");
+    }
+  }), std::runtime_error);
+  EXPECT_EQ(calls, 2u);
+}
+
+}  // namespace
@@ -0,0 +1,239 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// runs `text` through PrunedSax and JsonDomBuilder, as a pruned fetch does
+nlohmann::json prune(const std::string& text, const jfetch::JsonSelection& selection) {
+  nlohmann::json result;
+  jfetch::JsonDomBuilder<nlohmann::json> builder(result);
+  jfetch::PrunedSax<nlohmann::json> pruned(builder, selection);
+  nlohmann::json::sax_parse(text.begin(), text.end(), &pruned);
+  return result;
+}
+
+const char* const catalog = R"({
+  "total": 3,
+  "items": [
+    {"id": 10, "tags": ["a", "b"], "price": 1.5},
+    {"id": 20, "tags": [], "price": 2.5},
+    {"id": 30, "tags": ["c"], "price": null}
+  ],
+  "a/b": {"c~d": true, "e": false},
+  "meta": {"page": 1, "next": "/page/2"}
+})";
+
+TEST(JsonDomBuilderTest, BuildsTheSameDocumentAsParse) {
+  nlohmann::json expected = nlohmann::json::parse(catalog);
+  nlohmann::json built;
+  jfetch::JsonDomBuilder<nlohmann::json> builder(built);
+  std::string text = catalog;
+  ASSERT_TRUE(nlohmann::json::sax_parse(text.begin(), text.end(), &builder));
+  EXPECT_EQ(built, expected);
+}
+
+TEST(JsonDomBuilderTest, DuplicateKeysKeepTheLastValue) {
+  nlohmann::json built;
+  jfetch::JsonDomBuilder<nlohmann::json> builder(built);
+  std::string text = R"({"a": 1, "b": [1], "a": {"x": 2}})";
+  nlohmann::json::sax_parse(text.begin(), text.end(), &builder);
+  EXPECT_EQ(built, nlohmann::json::parse(text));
+  EXPECT_EQ(built["a"]["x"], 2);
+}
+
+TEST(JsonDomBuilderTest, SyntaxErrorsAreThrown) {
+  nlohmann::json built;
+  jfetch::JsonDomBuilder<nlohmann::json> builder(built);
+  std::string text = R"({"a": [1, 2,]})";
+  EXPECT_THROW(nlohmann::json::sax_parse(text.begin(), text.end(), &builder), nlohmann::json::parse_error);
+}
+
+TEST(JsonDomBuilderTest, KeepsBinaryValues) {
+  nlohmann::json document = {{"blob", nlohmann::json::binary({1, 2, 3}, 42)}, {"n", 1}};
+  std::vector<std::uint8_t> msgpack = nlohmann::json::to_msgpack(document);
+  nlohmann::json built;
+  jfetch::JsonDomBuilder<nlohmann::json> builder(built);
+  nlohmann::json::sax_parse(msgpack.begin(), msgpack.end(), &builder, nlohmann::json::input_format_t::msgpack);
+  EXPECT_EQ(built, document);
+}
+
+TEST(PrunedSaxTest, EmptyPointerSelectsEverything) {
+  EXPECT_EQ(prune(catalog, {""}), nlohmann::json::parse(catalog));
+}
+
+TEST(PrunedSaxTest, KeepsOnlySelectedMembers) {
+  nlohmann::json result = prune(catalog, {"/total", "/meta/next"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"total": 3, "meta": {"next": "/page/2"}})"));
+}
+
+TEST(PrunedSaxTest, PadsSkippedArrayElementsWithNull) {
+  nlohmann::json result = prune(catalog, {"/items/2/id"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"items": [null, null, {"id": 30}]})"));
+}
+
+TEST(PrunedSaxTest, PadsOnlyUpToTheHighestSelectedIndex) {
+  nlohmann::json result = prune(R"({"v": [0, 1, 2, 3, 4, 5]})", {"/v/1", "/v/3"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"v": [null, 1, null, 3]})"));
+}
+
+TEST(PrunedSaxTest, IndexBeyondTheArrayYieldsTheWholeArrayPadded) {
+  nlohmann::json result = prune(R"({"v": [0, 1]})", {"/v/5"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"v": [null, null]})"));
+}
+
+TEST(PrunedSaxTest, SelectedElementKeepsItsWholeSubtree) {
+  nlohmann::json result = prune(catalog, {"/items/0"});
+  EXPECT_EQ(result["items"], nlohmann::json::parse(R"([{"id": 10, "tags": ["a", "b"], "price": 1.5}])"));
+}
+
+TEST(PrunedSaxTest, LeadingZeroIsNotAnArrayIndex) {
+  nlohmann::json result = prune(R"({"v": [0, 1], "w": {"01": 7}})", {"/v/01", "/w/01"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"v": [], "w": {"01": 7}})"));
+}
+
+TEST(PrunedSaxTest, UnescapesTildeAndSlash) {
+  nlohmann::json result = prune(catalog, {"/a~1b/c~0d"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"a/b": {"c~d": true}})"));
+}
+
+TEST(PrunedSaxTest, TildeOneIsNotAPathSeparator) {
+  nlohmann::json result = prune(R"({"a": {"b": 1}, "a/b": 2})", {"/a~1b"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"a/b": 2})"));
+}
+
+TEST(PrunedSaxTest, TildeZeroOneUnescapesToTildeOne) {
+  nlohmann::json result = prune(R"({"~1": 1, "/": 2})", {"/~01"});
+  EXPECT_EQ(result, nlohmann::json::parse(R"({"~1": 1})"));
+}
+
+TEST(PrunedSaxTest, BinaryFormatsArePrunedLikeText) {
+  jfetch::JsonSelection selection{"/items/1/price", "/a~1b/e"};
+  nlohmann::json expected = prune(catalog, selection);
+  std::vector<std::uint8_t> cbor = nlohmann::json::to_cbor(nlohmann::json::parse(catalog));
+  std::vector<std::uint8_t> msgpack = nlohmann::json::to_msgpack(nlohmann::json::parse(catalog));
+
+  for (auto [bytes, format] : {std::pair{&cbor, nlohmann::json::input_format_t::cbor},
+                               std::pair{&msgpack, nlohmann::json::input_format_t::msgpack}}) {
+    nlohmann::json result;
+    jfetch::JsonDomBuilder<nlohmann::json> builder(result);
+    jfetch::PrunedSax<nlohmann::json> pruned(builder, selection);
+    nlohmann::json::sax_parse(bytes->begin(), bytes->end(), &pruned, format);
+    EXPECT_EQ(result, expected);
+  }
+}
+
+TEST(JsonSelectionTest, RejectsMalformedPointers) {
+  EXPECT_THROW(jfetch::JsonSelection({"total"}), jfetch::JFetchException);
+  EXPECT_THROW(jfetch::JsonSelection({"/a~2"}), jfetch::JFetchException);
+  EXPECT_THROW(jfetch::JsonSelection({"/a~"}), jfetch::JFetchException);
+  EXPECT_THROW(jfetch::JsonSelection(std::vector<std::string>{"/ok", "bad"}), jfetch::JFetchException);
+  EXPECT_NO_THROW(jfetch::JsonSelection({"/", "/~0~1", ""}));
+}
+
+// deep copy out of the arena
+nlohmann::json to_plain(const jfetch::ArenaJson& value) {
+  switch (value.type()) {
+    case nlohmann::json::value_t::object: {
+      nlohmann::json out = nlohmann::json::object();
+      for (const auto& [key, member] : value.items()) {
+        out[std::string(key.data(), key.size())] = to_plain(member);
+      }
+      return out;
+    }
+    case nlohmann::json::value_t::array: {
+      nlohmann::json out = nlohmann::json::array();
+      for (const jfetch::ArenaJson& element : value) {
+        out.push_back(to_plain(element));
+      }
+      return out;
+    }
+    case nlohmann::json::value_t::string: {
+      const auto& text = value.get_ref<const jfetch::ArenaJson::string_t&>();
+      return std::string(text.data(), text.size());
+    }
+    case nlohmann::json::value_t::boolean:
+      return value.get<bool>();
+    case nlohmann::json::value_t::number_integer:
+      return value.get<std::int64_t>();
+    case nlohmann::json::value_t::number_unsigned:
+      return value.get<std::uint64_t>();
+    case nlohmann::json::value_t::number_float:
+      return value.get<double>();
+    default:
+      return nullptr;
+  }
+}
+
+class SelectionFetchTest : public jfetch_test::MockFetchTest<nlohmann::json> {
+protected:
+  SelectionFetchTest() {
+    nlohmann::json document = nlohmann::json::parse(catalog);
+    std::vector<std::uint8_t> cbor = nlohmann::json::to_cbor(document);
+    std::vector<std::uint8_t> msgpack = nlohmann::json::to_msgpack(document);
+
+    // the catalog padded with a few hundred KiB of values nobody selects
+    nlohmann::json large = document;
+    for (int i = 0; i < 2000; ++i) {
+      large["items"].push_back({{"id", i}, {"tags", {"x", "y"}}, {"description", std::string(200, 'd')}});
+    }
+    std::vector<std::uint8_t> large_msgpack = nlohmann::json::to_msgpack(large);
+
+    for (std::string prefix : {"", "/arena"}) {
+      upstream_.route(prefix + "/json", catalog);
+      upstream_.route(prefix + "/cbor", std::string(cbor.begin(), cbor.end()), "application/cbor");
+      upstream_.route(prefix + "/msgpack", std::string(msgpack.begin(), msgpack.end()), "application/msgpack");
+      upstream_.route(prefix + "/broken", R"({"total": 3, "items": [)");
+      upstream_.route(prefix + "/large", large.dump());
+      upstream_.route(prefix + "/large/msgpack", std::string(large_msgpack.begin(), large_msgpack.end()),
+                      "application/msgpack");
+    }
+
+    jfetch::JsonSelection selection{"/total", "/items/1/tags", "/a~1b/c~0d"};
+    jfetch::Endpoint<nlohmann::json> plain{jfetch::RequestMethod::GET, jfetch_test::as_is};
+    plain.select = selection;
+    jfetch::Endpoint<nlohmann::json> arena{jfetch::RequestMethod::GET,
+                                           jfetch::with_arena([](const jfetch::ArenaJson& json_data) {
+      return to_plain(json_data);
+    })};
+    arena.select = selection;
+    for (const char* path : {"/json", "/cbor", "/msgpack", "/broken", "/large", "/large/msgpack"}) {
+      fetcher_.set_endpoint(path, plain);
+      fetcher_.set_endpoint(std::string("/arena") + path, arena);
+    }
+  }
+};
+
+TEST_F(SelectionFetchTest, EveryFormatAndDomYieldsTheSamePrunedDocument) {
+  nlohmann::json expected = nlohmann::json::parse(R"({"total": 3, "items": [null, {"tags": []}], "a/b": {"c~d": true}})");
+  for (const char* path : {"/json", "/cbor", "/msgpack", "/arena/json", "/arena/cbor", "/arena/msgpack"}) {
+    EXPECT_EQ(fetcher_.fetch(path), expected) << path;
+  }
+}
+
+TEST_F(SelectionFetchTest, ArenaHoldsOnlyTheSelectedValues) {
+  nlohmann::json expected = nlohmann::json::parse(R"({"total": 3, "items": [null, {"tags": []}], "a/b": {"c~d": true}})");
+  for (const char* path : {"/arena/large", "/arena/large/msgpack"}) {
+    // the decode arena draws its blocks from the default resource
+    jfetch_test::TrackingResource tracking;
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(&tracking);
+    nlohmann::json result = fetcher_.fetch(path);
+    std::pmr::set_default_resource(previous);
+    EXPECT_EQ(result, expected) << path;
+    EXPECT_GT(tracking.allocated_bytes(), 0u) << path;
+    EXPECT_LT(tracking.allocated_bytes(), 16u * 1024) << path;
+  }
+}
+
+TEST_F(SelectionFetchTest, SyntaxErrorsSurfaceAsParsingExceptions) {
+  EXPECT_THROW(fetcher_.fetch("/broken"), jfetch::JFetchParsingException);
+  EXPECT_THROW(fetcher_.fetch("/arena/broken"), jfetch::JFetchParsingException);
+}
+
+}  // namespace
@@ -0,0 +1,226 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+class RecordingSink : public jfetch::MetricsSink {
+public:
+  struct Entry {
+    std::string endpoint;
+    long http_status;
+    std::optional<jfetch::FetchErrorCode> error;
+  };
+
+  void record(const std::string& endpoint, const jfetch::FetchStats& stats, const jfetch::FetchError* error) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back({endpoint, stats.http_status, error ? std::optional(error->code()) : std::nullopt});
+  }
+
+  std::vector<Entry> entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<Entry> entries_;
+};
+
+struct RecordingTracer : jfetch::NullTracer {
+  static constexpr bool enabled = true;
+
+  std::vector<std::string> events;
+  std::optional<jfetch::FetchErrorCode> last_error;
+
+  void on_request_start(std::string_view endpoint, time_point) { events.push_back("start " + std::string(endpoint)); }
+  void on_dns(std::string_view endpoint, time_point) { events.push_back("dns " + std::string(endpoint)); }
+  void on_complete(std::string_view endpoint, time_point, const jfetch::FetchError* error) {
+    events.push_back("complete " + std::string(endpoint));
+    last_error = error ? std::optional(error->code()) : std::nullopt;
+  }
+};
+
+using TracedFetcher = jfetch_test::MockFetcher<int, RecordingTracer>;
+
+class EndpointNotFoundTest : public jfetch_test::MockFetchTest<int, RecordingTracer> {
+protected:
+  EndpointNotFoundTest() {
+    upstream_.route("/items", "[1, 2, 3]");
+    fetcher_.set_endpoint("/items", {jfetch::RequestMethod::GET, jfetch_test::count_elements});
+    fetcher_.set_metrics_sink(sink_);
+  }
+
+  // the sink saw exactly one EndpointNotFound for "/missing", and the tracer completed it
+  void expect_reported() {
+    std::vector<RecordingSink::Entry> entries = sink_->entries();
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].endpoint, "/missing");
+    EXPECT_EQ(entries[0].http_status, 0);
+    EXPECT_EQ(entries[0].error, jfetch::FetchErrorCode::EndpointNotFound);
+    EXPECT_EQ(fetcher_.tracer.events, (std::vector<std::string>{"start /missing", "complete /missing"}));
+    EXPECT_EQ(fetcher_.tracer.last_error, jfetch::FetchErrorCode::EndpointNotFound);
+    EXPECT_TRUE(upstream_.stats("/missing").requests == 0);
+    for (const jfetch::EndpointMetricsSnapshot& snapshot : fetcher_.metrics_snapshot()) {
+      EXPECT_NE(snapshot.endpoint, "/missing");
+    }
+  }
+
+  std::shared_ptr<RecordingSink> sink_ = std::make_shared<RecordingSink>();
+};
+
+TEST_F(EndpointNotFoundTest, RegisteredEndpointsAreReportedOnce) {
+  EXPECT_EQ(fetcher_.fetch("/items"), 3);
+  std::vector<RecordingSink::Entry> entries = sink_->entries();
+  ASSERT_EQ(entries.size(), 1u);
+  EXPECT_EQ(entries[0].http_status, 200);
+  EXPECT_FALSE(entries[0].error);
+  EXPECT_EQ(fetcher_.tracer.events.back(), "complete /items");
+}
+
+TEST_F(EndpointNotFoundTest, FetchReportsIt) {
+  EXPECT_THROW(fetcher_.fetch("/missing"), jfetch::JFetchEndpointNotFoundException);
+  expect_reported();
+}
+
+TEST_F(EndpointNotFoundTest, TryFetchReportsIt) {
+  jfetch::Expected<int> result = fetcher_.try_fetch("/missing");
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::EndpointNotFound);
+  expect_reported();
+}
+
+TEST_F(EndpointNotFoundTest, TryFetchEachReportsIt) {
+  jfetch::Expected<std::size_t> result = fetcher_.try_fetch_each("/missing", [](int&&) {});
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::EndpointNotFound);
+  expect_reported();
+}
+
+TEST_F(EndpointNotFoundTest, FetchAsyncReportsIt) {
+  std::future<int> future = fetcher_.fetch_async("/missing");
+  EXPECT_THROW(future.get(), jfetch::JFetchEndpointNotFoundException);
+  expect_reported();
+}
+
+TEST_F(EndpointNotFoundTest, FrozenFetcherReportsIt) {
+  fetcher_.freeze();
+  EXPECT_FALSE(fetcher_.try_fetch("/missing"));
+  expect_reported();
+}
+
+TEST(FetchStatsTest, OnlyTransfersPastConnectCountAsReused) {
+  jfetch_mock::MockUpstream upstream;
+  upstream.route("/items", "[1]");
+  upstream.start();
+  TracedFetcher fetcher(upstream.base_url());
+  fetcher.set_endpoint("/items", {jfetch::RequestMethod::GET, jfetch_test::count_elements});
+  jfetch::FetchStats stats;
+  ASSERT_TRUE(fetcher.try_fetch("/items", {}, {}, {}, &stats));
+  ASSERT_TRUE(fetcher.try_fetch("/items", {}, {}, {}, &stats));
+  EXPECT_TRUE(stats.connection_reused);
+
+  // nothing listens on the port any more, so the connect fails
+  upstream.stop();
+  jfetch::Expected<int> result = fetcher.try_fetch("/items", {}, {}, {}, &stats);
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Transport);
+  EXPECT_FALSE(stats.connection_reused);
+}
+
+// renders one endpoint named `name` that has a fetch in flight and one completed
+std::string render(const std::string& name, jfetch::MetricsFormat format) {
+  jfetch::EndpointMetrics metrics;
+  metrics.start();
+  metrics.start();
+  metrics.record(200, std::chrono::microseconds(1500), false, 10, 0);
+  auto for_each_endpoint = [&](auto&& visitor) { visitor(name, metrics); };
+  std::string out;
+  if (format == jfetch::MetricsFormat::Json) {
+    jfetch::MetricsExporter::json(out, for_each_endpoint);
+  } else {
+    jfetch::MetricsExporter::prometheus(out, for_each_endpoint);
+  }
+  return out;
+}
+
+TEST(MetricsExporterTest, JsonKeepsControlCharactersInEndpointNames) {
+  const std::string name = std::string("/a\"b\\c\n\t\r") + '\x01' + '\x1f' + "/\x7f";
+  std::string out = render(name, jfetch::MetricsFormat::Json);
+  EXPECT_NE(out.find(R"(\u0001\u001f)"), std::string::npos) << out;
+  nlohmann::json parsed = nlohmann::json::parse(out);
+  ASSERT_EQ(parsed["endpoints"].size(), 1u);
+  EXPECT_EQ(parsed["endpoints"][0]["endpoint"], name);
+  EXPECT_EQ(parsed["endpoints"][0]["in_flight"], 1);
+}
+
+TEST(MetricsExporterTest, PrometheusEscapesLabelValues) {
+  std::string out = render("/a\"b\\c\nd", jfetch::MetricsFormat::Prometheus);
+  EXPECT_NE(out.find(R"(jfetch_failures_total{endpoint="/a\"b\\c\nd"} 0)"), std::string::npos) << out;
+}
+
+TEST(MetricsExporterTest, ConnectionPoolIdleIsAGauge) {
+  jfetch::EndpointMetrics metrics;
+  auto for_each_endpoint = [&](auto&& visitor) { visitor("/items", metrics); };
+  std::string out;
+  jfetch::MetricsExporter::prometheus(out, for_each_endpoint, {3, std::nullopt});
+  EXPECT_NE(out.find("# TYPE jfetch_connection_pool_idle gauge\n"), std::string::npos) << out;
+  EXPECT_NE(out.find("jfetch_connection_pool_idle{pool=\"libcurl\"} 3\n"), std::string::npos) << out;
+  EXPECT_EQ(out.find("pool=\"transport\""), std::string::npos) << out;
+
+  out.clear();
+  jfetch::MetricsExporter::prometheus(out, for_each_endpoint, {3, 2});
+  EXPECT_NE(out.find("jfetch_connection_pool_idle{pool=\"transport\"} 2\n"), std::string::npos) << out;
+
+  out.clear();
+  jfetch::MetricsExporter::json(out, for_each_endpoint, {3, 2});
+  nlohmann::json parsed = nlohmann::json::parse(out);
+  EXPECT_EQ(parsed["connection_pool_idle"], (nlohmann::json{{"libcurl", 3}, {"transport", 2}}));
+}
+
+class IdleTransport : public jfetch::Transport {
+public:
+  jfetch::TransferResult perform(const jfetch::HttpClient& request, jfetch::ChunkedBuffer& response,
+                                 jfetch::FetchStats* stats) override {
+    return request.perform(response, stats);
+  }
+
+  std::size_t idle() const override { return 5; }
+};
+
+TEST(MetricsExporterTest, RenderMetricsReportsBothPools) {
+  jfetch_mock::MockUpstream upstream;
+  upstream.route("/items", "[1]");
+  upstream.start();
+  TracedFetcher fetcher(upstream.base_url());
+  fetcher.set_endpoint("/items", {jfetch::RequestMethod::GET, jfetch_test::count_elements});
+  ASSERT_TRUE(fetcher.try_fetch("/items"));
+  std::string out;
+  fetcher.render_metrics(out, jfetch::MetricsFormat::Json);
+  nlohmann::json pools = nlohmann::json::parse(out)["connection_pool_idle"];
+  EXPECT_EQ(pools["libcurl"], jfetch::CurlHandlePool::instance().idle());
+  EXPECT_GE(pools["libcurl"], 1u);
+  EXPECT_FALSE(pools.contains("transport"));
+
+  fetcher.set_transport(std::make_shared<IdleTransport>());
+  out.clear();
+  fetcher.render_metrics(out, jfetch::MetricsFormat::Json);
+  EXPECT_EQ(nlohmann::json::parse(out)["connection_pool_idle"]["transport"], 5);
+}
+
+TEST(MetricsExporterTest, InFlightIsAGauge) {
+  std::string out = render("/items", jfetch::MetricsFormat::Prometheus);
+  EXPECT_NE(out.find("# TYPE jfetch_in_flight gauge\n"), std::string::npos) << out;
+  EXPECT_NE(out.find("jfetch_in_flight{endpoint=\"/items\"} 1\n"), std::string::npos) << out;
+  EXPECT_NE(out.find("# TYPE jfetch_failures_total counter\n"), std::string::npos) << out;
+  EXPECT_NE(out.find("# TYPE jfetch_requests_total counter\n"), std::string::npos) << out;
+}
+
+}  // namespace
@@ -0,0 +1,71 @@
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <cstdio>
+#include <string>
+
+namespace {
+
+// virtual memory size of this process, in KiB
+std::size_t virtual_kib() {
+  std::size_t kib = 0;
+  if (FILE* status = std::fopen("/proc/self/status", "r")) {
+    char line[256];
+    while (std::fgets(line, sizeof(line), status)) {
+      if (std::sscanf(line, "VmSize: %zu kB", &kib) == 1) {
+        break;
+      }
+    }
+    std::fclose(status);
+  }
+  return kib;
+}
+
+class MockUpstreamTest : public ::testing::Test {
+protected:
+  MockUpstreamTest() {
+    upstream_.route("/upload", R"({"ok": 1})");
+    upstream_.start();
+  }
+
+  std::string post(const std::string& content_length, const std::string& body) {
+    return jfetch_test::raw_exchange(upstream_.port(), "POST /upload HTTP/1.1\r\nHost: mock\r\nConnection: close\r\n"
+                                                       "Content-Length: " + content_length + "\r\n\r\n" + body);
+  }
+
+  static bool is_status(const std::string& response, const char* status) {
+    return response.compare(0, 12, std::string("HTTP/1.1 ") + status) == 0;
+  }
+
+  jfetch_mock::MockUpstream upstream_;
+};
+
+TEST_F(MockUpstreamTest, MalformedContentLengthIsABadRequest) {
+  for (const char* length : {"abc", "", "12abc", "-1", "+5", "0x10", "99999999999999999999999"}) {
+    SCOPED_TRACE(length);
+    EXPECT_TRUE(is_status(post(length, "hello"), "400"));
+  }
+  EXPECT_EQ(upstream_.stats("/upload").requests, 0u);
+
+  // the server is still up and reads well-formed requests
+  EXPECT_TRUE(is_status(post("5", "hello"), "200"));
+  jfetch_mock::RouteStats stats = upstream_.stats("/upload");
+  EXPECT_EQ(stats.requests, 1u);
+  EXPECT_EQ(stats.body_bytes, 5u);
+}
+
+TEST_F(MockUpstreamTest, FinishedConnectionThreadsAreJoined) {
+  EXPECT_TRUE(is_status(post("0", ""), "200"));
+  std::size_t before = virtual_kib();
+  for (int i = 0; i < 300; ++i) {
+    ASSERT_TRUE(is_status(post("0", ""), "200"));
+  }
+  // an unjoined thread keeps its whole stack mapped, megabytes each; joined stacks are
+  // only partly cached by the C library, and a few workers lag one accept behind
+  EXPECT_LT(virtual_kib(), before + 256 * 1024);
+  EXPECT_EQ(upstream_.stats("/upload").requests, 301u);
+}
+
+}  // namespace
@@ -0,0 +1,110 @@
+#include "../include/jfetch.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> destroyed{0};
+
+void count_destroyed(const void*) {
+  ++destroyed;
+}
+
+class EpochDomainTest : public ::testing::Test {
+protected:
+  EpochDomainTest() { destroyed = 0; }
+
+  jfetch::EpochDomain& domain_ = jfetch::EpochDomain::instance();
+  int object_ = 0;
+};
+
+TEST_F(EpochDomainTest, UnreadObjectsAreFreedRightAway) {
+  domain_.retire(&object_, count_destroyed);
+  EXPECT_EQ(destroyed, 1);
+}
+
+TEST_F(EpochDomainTest, ReaderOnThisThreadDefersTheFree) {
+  {
+    jfetch::EpochDomain::Guard outer;
+    {
+      jfetch::EpochDomain::Guard nested;
+      domain_.retire(&object_, count_destroyed);
+    }
+    EXPECT_EQ(destroyed, 0);
+  }
+  EXPECT_EQ(destroyed, 1);
+}
+
+TEST_F(EpochDomainTest, LastReaderOnAnotherThreadFreesIt) {
+  std::promise<void> pinned;
+  std::promise<void> retired;
+  std::thread reader([&] {
+    jfetch::EpochDomain::Guard guard;
+    pinned.set_value();
+    retired.get_future().wait();
+  });
+  pinned.get_future().wait();
+  domain_.retire(&object_, count_destroyed);
+  EXPECT_EQ(destroyed, 0);
+
+  // a reader that pins after the retirement cannot see the object and does not hold it
+  {
+    jfetch::EpochDomain::Guard later;
+    retired.set_value();
+    reader.join();
+  }
+  EXPECT_EQ(destroyed, 1);
+}
+
+struct DiscardingSink : jfetch::MetricsSink {
+  void record(const std::string&, const jfetch::FetchStats&, const jfetch::FetchError*) override {}
+};
+
+class FrozenSnapshotTest : public jfetch_test::MockFetchTest<int> {
+protected:
+  FrozenSnapshotTest() {
+    upstream_.route("/items", "[1, 2, 3]");
+    fetcher_.set_endpoint("/items", {jfetch::RequestMethod::GET, jfetch_test::count_elements});
+  }
+};
+
+TEST_F(FrozenSnapshotTest, ReconfiguringWhileFetchingFreesSupersededSnapshots) {
+  auto sink = std::make_shared<DiscardingSink>();
+  fetcher_.set_metrics_sink(sink);
+  fetcher_.freeze();
+
+  std::atomic<bool> done{false};
+  std::atomic<int> failures{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!done) {
+        jfetch::Expected<int> result = fetcher_.try_fetch("/items");
+        failures += !result || *result != 3;
+      }
+    });
+  }
+  for (int i = 0; i < 200; ++i) {
+    fetcher_.set_global_headers({"X-Token: " + std::to_string(i)});
+  }
+  done = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(failures, 0);
+
+  // every snapshot holds the sink; only the current one and the fetcher's own copy are left
+  fetcher_.set_global_headers({});
+  EXPECT_EQ(sink.use_count(), 3);
+}
+
+}  // namespace
@@ -0,0 +1,110 @@
+#ifndef JFETCH_TEST_SUPPORT_HPP
+#define JFETCH_TEST_SUPPORT_HPP
+
+#include "../include/jfetch.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <cstddef>
+#include <memory_resource>
+#include <set>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace jfetch_test {
+
+// sends `request` over a fresh loopback connection and returns everything the server sends back
+inline std::string raw_exchange(unsigned short port, const std::string& request) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  std::string response;
+  if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+      ::send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size())) {
+    char chunk[4096];
+    ssize_t n;
+    while ((n = ::recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+      response.append(chunk, static_cast<std::size_t>(n));
+    }
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  return response;
+}
+
+// heap-backed resource that remembers which blocks it handed out
+class TrackingResource : public std::pmr::memory_resource {
+public:
+  std::size_t live() const { return blocks_.size(); }
+  std::size_t allocated_bytes() const { return allocated_bytes_; }
+  std::size_t foreign_frees() const { return foreign_frees_; }
+
+private:
+  std::set<void*> blocks_;
+  std::size_t allocated_bytes_ = 0;
+  std::size_t foreign_frees_ = 0;
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    void* block = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    blocks_.insert(block);
+    allocated_bytes_ += bytes;
+    return block;
+  }
+
+  void do_deallocate(void* block, std::size_t bytes, std::size_t alignment) override {
+    if (blocks_.erase(block) == 0) {
+      ++foreign_frees_;
+      return;
+    }
+    std::pmr::new_delete_resource()->deallocate(block, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// fetcher pointed at a mock upstream; tests register their endpoints with set_endpoint()
+template <typename T, typename Tracer = jfetch::NullTracer>
+class MockFetcher : public jfetch::JFetch<T, Tracer> {
+public:
+  explicit MockFetcher(std::string base) : base_(std::move(base)) {}
+
+  using jfetch::JFetch<T, Tracer>::tracer;
+
+protected:
+  std::string get_base() const override { return base_; }
+
+private:
+  std::string base_;
+};
+
+// a mock upstream and a fetcher for it; the derived fixture's constructor adds routes and
+// endpoints, and the upstream starts accepting before each test body
+template <typename T, typename Tracer = jfetch::NullTracer>
+class MockFetchTest : public ::testing::Test {
+protected:
+  void SetUp() override { upstream_.start(); }
+
+  jfetch_mock::MockUpstream upstream_;
+  MockFetcher<T, Tracer> fetcher_{upstream_.base_url()};
+};
+
+// decoders shared by tests that only check what arrived
+inline int count_elements(const nlohmann::json& json_data) {
+  return static_cast<int>(json_data.size());
+}
+
+inline nlohmann::json as_is(const nlohmann::json& json_data) {
+  return json_data;
+}
+
+}  // namespace jfetch_test
+
+#endif  // JFETCH_TEST_SUPPORT_HPP
@@ -0,0 +1,100 @@
+#include "../include/jfetch.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include "../include/jfetch_uring.hpp"
+
+#include "test_support.hpp"
+
+#include <gtest/gtest.h>
+#include <jfetch_mock/mock_upstream.hpp>
+
+#include <memory>
+#include <string>
+
+namespace {
+
+class UringTransportTest : public jfetch_test::MockFetchTest<nlohmann::json> {
+protected:
+  void SetUp() override {
+    if (!jfetch::UringTransport::supported()) {
+      GTEST_SKIP() << "io_uring unavailable";
+    }
+    upstream_.route("/items", R"([1, 2, 3])");
+    upstream_.route("/upload", R"({"ok": true})");
+    MockFetchTest::SetUp();
+    fetcher_.set_endpoint("/items", {jfetch::RequestMethod::GET, jfetch_test::as_is});
+    fetcher_.set_endpoint("/upload", {jfetch::RequestMethod::POST, jfetch_test::as_is});
+    jfetch::Endpoint<nlohmann::json> encoded{jfetch::RequestMethod::GET, jfetch_test::as_is};
+    encoded.accept_compressed = true;
+    fetcher_.set_endpoint("/encoded", encoded);
+    fetcher_.set_endpoint("/encoded/corrupt", encoded);
+    fetcher_.set_transport(std::make_shared<jfetch::UringTransport>());
+  }
+};
+
+TEST_F(UringTransportTest, BodiesLargerThanTheSendBufferArriveIntact) {
+  std::string body(300 * 1024, '\0');
+  for (std::size_t i = 0; i < body.size(); ++i) {
+    body[i] = static_cast<char>(i * 31 + 7);
+  }
+  for (int round = 0; round < 2; ++round) {
+    jfetch::FetchStats stats;
+    jfetch::Expected<nlohmann::json> result = fetcher_.try_fetch("/upload", {}, {}, jfetch::RequestBody(body), &stats);
+    ASSERT_TRUE(result) << result.error().message();
+    EXPECT_EQ((*result)["ok"], true);
+    EXPECT_EQ(stats.request_bytes, body.size());
+    EXPECT_EQ(stats.connection_reused, round > 0);
+
+    jfetch_mock::BodyDigest digest;
+    digest.update(body.data(), body.size());
+    jfetch_mock::RouteStats route = upstream_.stats("/upload");
+    EXPECT_EQ(route.body_bytes, body.size());
+    EXPECT_EQ(route.body_digest, digest.value());
+  }
+  // a request without a body still goes out from the registered buffer on the same connection
+  jfetch::FetchStats stats;
+  EXPECT_EQ(fetcher_.fetch("/items", {}, {}, "", &stats), nlohmann::json({1, 2, 3}));
+  EXPECT_TRUE(stats.connection_reused);
+}
+
+#if defined(JFETCH_WITH_ZLIB)
+TEST_F(UringTransportTest, DecodesCompressedResponses) {
+  nlohmann::json document = nlohmann::json::array();
+  for (int i = 0; i < 2000; ++i) {
+    document.push_back({{"id", i}, {"name", "item " + std::to_string(i)}});
+  }
+  std::string text = document.dump();
+
+  z_stream stream{};
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+  std::string compressed(deflateBound(&stream, text.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(text.data());
+  stream.avail_in = static_cast<uInt>(text.size());
+  stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+  stream.avail_out = static_cast<uInt>(compressed.size());
+  deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  jfetch_mock::RouteSpec encoded;
+  encoded.body = compressed;
+  encoded.content_encoding = "gzip";
+  upstream_.route("/encoded", encoded);
+  jfetch_mock::RouteSpec corrupt = encoded;
+  corrupt.body.resize(corrupt.body.size() / 2);
+  upstream_.route("/encoded/corrupt", corrupt);
+
+  jfetch::FetchStats stats;
+  EXPECT_EQ(fetcher_.fetch("/encoded", {}, {}, "", &stats), document);
+  EXPECT_EQ(stats.body_bytes, text.size());
+
+  jfetch::Expected<nlohmann::json> result = fetcher_.try_fetch("/encoded/corrupt");
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code(), jfetch::FetchErrorCode::Transport);
+  EXPECT_EQ(result.error().curl_code(), CURLE_BAD_CONTENT_ENCODING);
+}
+#endif
+
+}  // namespace
+
+#endif
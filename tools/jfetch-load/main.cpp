@@ -0,0 +1,281 @@
+/**
+ * @file main.cpp
+ * @brief jfetch-load - open-loop load generator driving JFetch at a fixed request rate.
+ *
+ * Requests are scheduled at `start + i / rate` regardless of how long earlier
+ * ones took, and latency is measured from that intended send time. A slow
+ * upstream therefore shows up as queueing delay in the percentiles instead of
+ * silently lowering the offered load (coordinated omission).
+ *
+ * Workers claim slot indices from one shared counter and sleep until the slot
+ * is due, so the schedule is open-loop only while a worker is free at each due
+ * time: `--threads` must cover rate x latency. Past that, sends start late
+ * (counted as late starts) and the achieved rate drops below the target.
+ * Queueing delay still lands in the intended-time histogram, but the upstream
+ * sees fewer concurrent requests than a real open-loop client would send.
+ *
+ * Two histograms are kept: `intended` measures from the scheduled send time
+ * (what a caller on that schedule experiences), `service` from the actual send
+ * time (what the upstream and client take per request). A growing gap between
+ * them is local queueing, not a slower upstream.
+ */
+
+#include "../../include/jfetch.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::string url;
+  jfetch::RequestMethod method = jfetch::RequestMethod::GET;
+  std::vector<std::string> headers;
+  std::string body;
+  double rate = 100;
+  double duration = 10;
+  unsigned threads = 16;
+  bool json = false;
+};
+
+[[noreturn]] void usage(const char* message = nullptr) {
+  if (message) {
+    std::cerr << "jfetch-load: " << message << "\n\n";
+  }
+  std::cerr <<
+    "Usage: jfetch-load --url URL [options]\n"
+    "\n"
+    "  --url URL          Endpoint to load, e.g. http://127.0.0.1:8080/products?limit=10\n"
+    "  --method METHOD    GET (default), POST, PUT, DELETE or PATCH\n"
+    "  --header LINE      Extra request header, e.g. \"Authorization: Bearer x\" (repeatable)\n"
+    "  --body TEXT        Request body\n"
+    "  --body-file PATH   Request body read from a file\n"
+    "  --rate N           Target requests per second (default 100)\n"
+    "  --duration SECS    Test length in seconds (default 10)\n"
+    "  --threads N        Concurrent workers; must cover rate x latency (default 16)\n"
+    "  --json             Print the report as JSON\n";
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        usage(("missing value for " + arg).c_str());
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--url") {
+      options.url = value();
+    } else if (arg == "--method") {
+      std::string method = value();
+      if (method == "GET") options.method = jfetch::RequestMethod::GET;
+      else if (method == "POST") options.method = jfetch::RequestMethod::POST;
+      else if (method == "PUT") options.method = jfetch::RequestMethod::PUT;
+      else if (method == "DELETE") options.method = jfetch::RequestMethod::DEL;
+      else if (method == "PATCH") options.method = jfetch::RequestMethod::PATCH;
+      else usage("unknown method");
+    } else if (arg == "--header") {
+      options.headers.push_back(value());
+    } else if (arg == "--body") {
+      options.body = value();
+    } else if (arg == "--body-file") {
+      std::ifstream file(value(), std::ios::binary);
+      if (!file) {
+        usage("cannot read body file");
+      }
+      std::ostringstream contents;
+      contents << file.rdbuf();
+      options.body = contents.str();
+    } else if (arg == "--rate") {
+      options.rate = std::atof(value().c_str());
+    } else if (arg == "--duration") {
+      options.duration = std::atof(value().c_str());
+    } else if (arg == "--threads") {
+      options.threads = static_cast<unsigned>(std::atoi(value().c_str()));
+    } else if (arg == "--json") {
+      options.json = true;
+    } else if (arg == "--help" || arg == "-h") {
+      usage();
+    } else {
+      usage(("unknown option " + arg).c_str());
+    }
+  }
+
+  if (options.url.empty()) usage("--url is required");
+  if (options.rate <= 0) usage("--rate must be positive");
+  if (options.duration <= 0) usage("--duration must be positive");
+  if (options.threads == 0) usage("--threads must be positive");
+  return options;
+}
+
+/**
+ * @brief Fetcher with a single endpoint built from the --url option.
+ */
+class LoadFetcher : public jfetch::JFetch<std::size_t> {
+public:
+  LoadFetcher(const Options& options, std::string base, const std::string& endpoint)
+    : base_(std::move(base)) {
+    endpoint_lookup[endpoint] = {options.method, [](const nlohmann::json& json_data) {
+      return json_data.size();
+    }};
+    set_global_headers(options.headers);
+  }
+
+protected:
+  std::string get_base() const override { return base_; }
+
+private:
+  std::string base_;
+};
+
+struct Target {
+  std::string base;
+  std::string endpoint;
+  std::unordered_map<std::string, std::string> query;
+};
+
+Target split_url(const std::string& url) {
+  Target target;
+  std::size_t scheme = url.find("://");
+  std::size_t path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+  target.base = url.substr(0, path);
+  std::string rest = path == std::string::npos ? "/" : url.substr(path);
+
+  std::size_t question = rest.find('?');
+  target.endpoint = rest.substr(0, question);
+  if (question != std::string::npos) {
+    std::istringstream pairs(rest.substr(question + 1));
+    std::string pair;
+    while (std::getline(pairs, pair, '&')) {
+      std::size_t equals = pair.find('=');
+      target.query[pair.substr(0, equals)] = equals == std::string::npos ? "" : pair.substr(equals + 1);
+    }
+  }
+  return target;
+}
+
+void print_summary(const char* name, const jfetch::LatencySummary& summary, bool json) {
+  if (json) {
+    std::printf("\"%s\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu,\"mean\":%.1f}",
+                name, static_cast<unsigned long long>(summary.p50), static_cast<unsigned long long>(summary.p90),
+                static_cast<unsigned long long>(summary.p99), static_cast<unsigned long long>(summary.p999),
+                static_cast<unsigned long long>(summary.max), summary.mean);
+  } else {
+    std::printf("%-28s p50 %8llu  p90 %8llu  p99 %8llu  p99.9 %8llu  max %8llu  (us)\n",
+                name, static_cast<unsigned long long>(summary.p50), static_cast<unsigned long long>(summary.p90),
+                static_cast<unsigned long long>(summary.p99), static_cast<unsigned long long>(summary.p999),
+                static_cast<unsigned long long>(summary.max));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options = parse_options(argc, argv);
+  Target target = split_url(options.url);
+
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  using clock = std::chrono::steady_clock;
+  const auto interval = std::chrono::duration<double>(1.0 / options.rate);
+  const auto total = static_cast<std::uint64_t>(options.rate * options.duration);
+
+  jfetch::LatencyHistogram intended;  // from the scheduled send time
+  jfetch::LatencyHistogram service;   // from the actual send time
+  std::atomic<std::uint64_t> next{0};
+  std::atomic<std::uint64_t> ok{0};
+  std::atomic<std::uint64_t> late{0};
+  std::array<std::atomic<std::uint64_t>, 6> errors{};
+
+  // one fetcher shared by every worker
+  LoadFetcher fetcher(options, target.base, target.endpoint);
+  fetcher.freeze();
+
+  const auto start = clock::now() + std::chrono::milliseconds(100);
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < options.threads; ++t) {
+    workers.emplace_back([&] {
+      for (std::uint64_t i = next.fetch_add(1); i < total; i = next.fetch_add(1)) {
+        auto scheduled = start + std::chrono::duration_cast<clock::duration>(interval * static_cast<double>(i));
+        auto now = clock::now();
+        if (now < scheduled) {
+          std::this_thread::sleep_until(scheduled);
+        } else if (now - scheduled > std::chrono::milliseconds(1)) {
+          late.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        auto sent = clock::now();
+        auto result = fetcher.try_fetch(target.endpoint, target.query, {}, options.body);
+        auto done = clock::now();
+
+        intended.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(done - scheduled).count()));
+        service.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(done - sent).count()));
+        if (result) {
+          ok.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          errors[static_cast<std::size_t>(result.error().code())].fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+  std::uint64_t failed = total - ok.load();
+  const char* error_names[] = {"endpoint_not_found", "curl_init", "transport", "http_status", "parse", "decode"};
+
+  if (options.json) {
+    std::printf("{\"target_rate\":%.1f,\"achieved_rate\":%.1f,\"requests\":%llu,\"ok\":%llu,\"errors\":%llu,\"late_starts\":%llu,",
+                options.rate, static_cast<double>(total) / elapsed, static_cast<unsigned long long>(total),
+                static_cast<unsigned long long>(ok.load()), static_cast<unsigned long long>(failed),
+                static_cast<unsigned long long>(late.load()));
+    print_summary("latency_us", intended.snapshot().summary(), true);
+    std::printf(",");
+    print_summary("service_time_us", service.snapshot().summary(), true);
+    std::printf(",\"errors_by_code\":{");
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+      std::printf("%s\"%s\":%llu", i ? "," : "", error_names[i], static_cast<unsigned long long>(errors[i].load()));
+    }
+    std::printf("}}\n");
+  } else {
+    std::printf("target %s at %.1f req/s for %.1fs with %u workers\n", options.url.c_str(), options.rate,
+                options.duration, options.threads);
+    std::printf("requests %llu  ok %llu  errors %llu (%.2f%%)  achieved %.1f req/s\n",
+                static_cast<unsigned long long>(total), static_cast<unsigned long long>(ok.load()),
+                static_cast<unsigned long long>(failed), total ? 100.0 * static_cast<double>(failed) / static_cast<double>(total) : 0.0,
+                static_cast<double>(total) / elapsed);
+    print_summary("latency (from intended)", intended.snapshot().summary(), false);
+    print_summary("service time (from send)", service.snapshot().summary(), false);
+    if (late.load() > 0) {
+      std::printf("%llu requests started >1ms late; add --threads if this grows with the rate\n",
+                  static_cast<unsigned long long>(late.load()));
+    }
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+      if (errors[i].load() > 0) {
+        std::printf("  %-20s %llu\n", error_names[i], static_cast<unsigned long long>(errors[i].load()));
+      }
+    }
+  }
+
+  // pooled handles must be cleaned up while libcurl is still initialised
+  jfetch::CurlHandlePool::instance().clear();
+  curl_global_cleanup();
+  return failed == total && total > 0 ? 1 : 0;
+}